@@ -0,0 +1,197 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "channel.h"
+#include "mainwindow.h"
+#include "show.h"
+#include "renderer.h"
+#include "framering.h"
+#include "scaledoutput.h"
+#include "rundown.h"
+
+#include <QQuickItem>
+#include <QSettings>
+#include <QFileInfo>
+
+Channel::Channel(int id, MainWindow *mainWindow) :
+    QObject(mainWindow), m_id(id), m_mainWindow(mainWindow), m_frameRing(0), m_show(0)
+{
+    m_renderer = new Renderer(this);
+}
+
+Channel::~Channel()
+{
+    // The graphics' items have to go before the scene and the engine
+    if(m_show)
+    {
+        m_show->save();
+        delete m_show;
+        m_show = 0;
+    }
+}
+
+QString Channel::savedShow() const
+{
+    // The first channel keeps the key used before there were several channels
+    if(m_id == 0)
+    {
+        return QSettings().value("CurrentShow").toString();
+    }
+
+    return QSettings().value(QString("Channel%1/CurrentShow").arg(m_id)).toString();
+}
+
+void Channel::saveShow()
+{
+    if(!m_show)
+    {
+        return;
+    }
+
+    m_show->save();
+
+    if(m_id == 0)
+    {
+        QSettings().setValue("CurrentShow", m_show->showName());
+    }
+    else
+    {
+        QSettings().setValue(QString("Channel%1/CurrentShow").arg(m_id), m_show->showName());
+    }
+}
+
+void Channel::setCurrentShow(const QString &show)
+{
+    if(m_show)
+    {
+        m_show->save();
+        closeShow();
+    }
+
+    QString absolutePath = m_mainWindow->showDir().absoluteFilePath(show);
+    QFileInfo info;
+    info.setFile(absolutePath);
+
+    if(info.exists() && info.isFile())
+    {
+        m_show = new Show(this);
+        m_show->load(absolutePath);
+
+        connect(m_show, SIGNAL(graphicStateChanged(QString,int)),
+                this, SLOT(onGraphicStateChanged(QString,int)));
+        connect(m_show, SIGNAL(graphicCued(QString,bool)),
+                this, SLOT(onGraphicCued(QString,bool)));
+        connect(m_show, SIGNAL(graphicsCleared(QString,QStringList)),
+                this, SLOT(onGraphicsCleared(QString,QStringList)));
+        connect(m_show, SIGNAL(rundownStatusChanged()),
+                this, SLOT(onRundownStatusChanged()));
+        connect(m_show, SIGNAL(loadProgress(int,int)),
+                this, SLOT(onLoadProgress(int,int)));
+
+        emit showChanged(m_id);
+    }
+}
+
+void Channel::closeShow()
+{
+    if(!m_show)
+    {
+        return;
+    }
+
+    // The show lives on until the event loop deletes it, it must not
+    // report to this channel or run its rundown in the meantime
+    disconnect(m_show, 0, this, 0);
+
+    foreach(const QString &graphic, m_show->graphics())
+    {
+        disconnect(m_show->graphicFromName(graphic), 0, this, 0);
+    }
+
+    m_show->rundown()->stop();
+
+    m_show->deleteLater();
+    m_show = 0;
+}
+
+bool Channel::openFrameRing(const QString &name)
+{
+    if(!m_frameRing)
+    {
+        m_frameRing = new FrameRing(this);
+        connect(m_renderer, SIGNAL(frameRendered(QImage)),
+                m_frameRing, SLOT(writeFrame(QImage)), Qt::DirectConnection);
+    }
+
+    return m_frameRing->open(name, m_renderer->outputSize());
+}
+
+bool Channel::addScaledOutput(const QString &name, const QSize &size)
+{
+    // Scaled from the full resolution render instead of rendering the scene again
+    ScaledOutput *output = new ScaledOutput(size, this);
+    connect(m_renderer, SIGNAL(frameRendered(QImage)),
+            output, SLOT(addFrame(QImage)), Qt::DirectConnection);
+    m_scaledOutputs.append(output);
+
+    return output->open(name);
+}
+
+void Channel::addItem(QQuickItem *item)
+{
+    if(!item)
+    {
+        return;
+    }
+
+    item->setParentItem(m_renderer->rootItem());
+    m_renderer->invalidate();
+}
+
+void Channel::processFrame()
+{
+    // Graphic state and property changes queued since the last tick land together on this frame
+    if(m_show && m_show->processFrame(m_renderer->stats()))
+    {
+        m_renderer->invalidate();
+    }
+
+    m_renderer->renderFrame();
+}
+
+void Channel::onGraphicStateChanged(const QString &graphic, int state)
+{
+    emit graphicStateChanged(m_id, graphic, state);
+}
+
+void Channel::onGraphicCued(const QString &graphic, bool ready)
+{
+    emit graphicCued(m_id, graphic, ready);
+}
+
+void Channel::onGraphicsCleared(const QString &group, const QStringList &graphics)
+{
+    emit graphicsCleared(m_id, group, graphics);
+}
+
+void Channel::onRundownStatusChanged()
+{
+    emit rundownStatusChanged(m_id);
+}
+
+void Channel::onLoadProgress(int loaded, int total)
+{
+    emit loadProgress(m_id, m_show ? m_show->showName() : QString(), loaded, total);
+}
@@ -0,0 +1,85 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <QObject>
+#include <QList>
+
+class QQuickItem;
+class MainWindow;
+class Show;
+class Renderer;
+class FrameRing;
+class ScaledOutput;
+class QSize;
+
+// One independent output: a scene with its own renderer, current show
+// and outputs. All channels share the QML engine of the main window.
+class Channel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Channel(int id, MainWindow *mainWindow);
+    ~Channel();
+
+    int id() const { return m_id; }
+    MainWindow* mainWindow() const { return m_mainWindow; }
+    Renderer* renderer() const { return m_renderer; }
+
+    Show* currentShow() const { return m_show; }
+    void setCurrentShow(const QString &show);
+    void closeShow();
+
+    QString savedShow() const;
+    void saveShow();
+
+    bool openFrameRing(const QString &name);
+    bool addScaledOutput(const QString &name, const QSize &size);
+    QList<ScaledOutput*> scaledOutputs() const { return m_scaledOutputs; }
+
+    void processFrame();
+
+public slots:
+    void addItem(QQuickItem *item);
+
+protected slots:
+    void onGraphicStateChanged(const QString &graphic, int state);
+    void onGraphicCued(const QString &graphic, bool ready);
+    void onGraphicsCleared(const QString &group, const QStringList &graphics);
+    void onRundownStatusChanged();
+    void onLoadProgress(int loaded, int total);
+
+private:
+    int m_id;
+    MainWindow *m_mainWindow;
+
+    Renderer *m_renderer;
+    FrameRing *m_frameRing;
+    QList<ScaledOutput*> m_scaledOutputs;
+
+    Show *m_show;
+
+signals:
+    void graphicStateChanged(int channel, const QString &graphic, int state);
+    void graphicCued(int channel, const QString &graphic, bool ready);
+    void graphicsCleared(int channel, const QString &group, const QStringList &graphics);
+    void rundownStatusChanged(int channel);
+    void showChanged(int channel);
+    void loadProgress(int channel, const QString &show, int loaded, int total);
+};
+
+#endif // CHANNEL_H
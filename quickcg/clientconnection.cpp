@@ -17,6 +17,18 @@
 #include "server.h"
 #include "mainwindow.h"
 #include "show.h"
+#include "channel.h"
+#include "renderer.h"
+#include "renderstats.h"
+#include "frameclock.h"
+#include "recorder.h"
+#include "scaledoutput.h"
+#include "thumbnailrenderer.h"
+#include "templatecache.h"
+#include "templateschema.h"
+#include "directoryindex.h"
+#include "rundown.h"
+#include "datafeed.h"
 
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -70,16 +82,31 @@ void ClientConnection::parseCommand(const QJsonDocument &jsonDoc)
         return;
     }
 
+    // Commands without a channel address the first one, like before there were several
+    int channelId = jsonObject.value("Channel").toInt(0);
+    m_channel = m_server->mainWindow()->channel(channelId);
+
+    if(!m_channel)
+    {
+        qDebug() << "Command for unknown channel" << channelId;
+        return;
+    }
+
     QByteArray command = m_commandHash.value(jsonObject.value("Command").toString());
     QJsonValue data = jsonObject.value("Data");
     QMetaObject::invokeMethod(this, command, Q_ARG(QJsonValue, data));
 }
 
-void ClientConnection::sendCommand(const QString &command, const QJsonValue &data)
+void ClientConnection::sendCommand(const QString &command, const QJsonValue &data, int channel)
 {
     QJsonObject commandObject;
     commandObject.insert("Command", command);
 
+    if(channel >= 0)
+    {
+        commandObject.insert("Channel", channel);
+    }
+
     if(!data.isNull())
     {
         commandObject.insert("Data", data);
@@ -92,53 +119,153 @@ void ClientConnection::sendCommand(const QString &command, const QJsonValue &dat
     m_socket->write(commandarray);
 }
 
+Show* ClientConnection::currentShow() const
+{
+    if(!m_channel)
+    {
+        return 0;
+    }
+
+    return m_channel->currentShow();
+}
+
 void ClientConnection::initCommandHash()
 {
     m_commandHash.insert("list graphics", "parseListGraphics");
     m_commandHash.insert("toggle state", "parseToggleState");
+    m_commandHash.insert("cue graphic", "parseCueGraphic");
+    m_commandHash.insert("clear group", "parseClearGroup");
+    m_commandHash.insert("clear all", "parseClearAll");
     m_commandHash.insert("list templates", "parseListTemplates");
+    m_commandHash.insert("get template index", "parseGetTemplateIndex");
     m_commandHash.insert("create graphic", "parseCreateGraphic");
     m_commandHash.insert("get properties", "parseGetProperties");
     m_commandHash.insert("set graphic properties", "parseSetGraphicProperties");
     m_commandHash.insert("remove graphic", "parseRemoveGraphic");
+    m_commandHash.insert("transaction", "parseTransaction");
+    m_commandHash.insert("get rundown", "parseGetRundown");
+    m_commandHash.insert("set rundown", "parseSetRundown");
+    m_commandHash.insert("arm rundown", "parseArmRundown");
+    m_commandHash.insert("pause rundown", "parsePauseRundown");
+    m_commandHash.insert("resume rundown", "parseResumeRundown");
+    m_commandHash.insert("stop rundown", "parseStopRundown");
+    m_commandHash.insert("get rundown status", "parseGetRundownStatus");
+    m_commandHash.insert("list feeds", "parseListFeeds");
+    m_commandHash.insert("add feed", "parseAddFeed");
+    m_commandHash.insert("remove feed", "parseRemoveFeed");
+    m_commandHash.insert("get feed bindings", "parseGetFeedBindings");
+    m_commandHash.insert("set feed bindings", "parseSetFeedBindings");
     m_commandHash.insert("list shows", "parseListShows");
+    m_commandHash.insert("get show index", "parseGetShowIndex");
     m_commandHash.insert("create show", "parseCreateShow");
     m_commandHash.insert("change current show", "parseChangeCurrentShow");
     m_commandHash.insert("remove show", "parseRemoveShow");
+    m_commandHash.insert("get frame stats", "parseGetFrameStats");
+    m_commandHash.insert("start recording", "parseStartRecording");
+    m_commandHash.insert("stop recording", "parseStopRecording");
+    m_commandHash.insert("get cache stats", "parseGetCacheStats");
+    m_commandHash.insert("get render stats", "parseGetRenderStats");
+    m_commandHash.insert("get thumbnail", "parseGetThumbnail");
 }
 
 void ClientConnection::parseListGraphics(const QJsonValue &data)
 {
     Q_UNUSED(data)
 
-    if(!m_server->mainWindow()->currentShow())
+    if(!currentShow())
     {
         return;
     }
 
-    QStringList graphics = m_server->mainWindow()->currentShow()->graphics();
+    QStringList graphics = currentShow()->graphics();
 
-    sendCommand("graphics", QJsonArray::fromStringList(graphics));
+    sendCommand("graphics", QJsonArray::fromStringList(graphics), m_channel->id());
 }
 
 void ClientConnection::parseToggleState(const QJsonValue &data)
 {
-    if(!m_server->mainWindow()->currentShow())
+    if(!currentShow())
     {
         return;
     }
 
     QString graphic = data.toString();
-    m_server->mainWindow()->currentShow()->setGraphicOnAir(graphic, !m_server->mainWindow()->currentShow()->isGraphicOnAir(graphic));
+    currentShow()->setGraphicOnAir(graphic, !currentShow()->isGraphicOnAir(graphic));
+}
+
+void ClientConnection::parseCueGraphic(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    currentShow()->cueGraphic(data.toString());
 }
 
-void ClientConnection::sendGraphicStateChanged(const QString &graphic, bool state)
+void ClientConnection::parseClearGroup(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    QString group = data.toString();
+
+    if(group.isEmpty())
+    {
+        qDebug() << "Invalid clear group command";
+        return;
+    }
+
+    currentShow()->clearGroup(group);
+}
+
+void ClientConnection::parseClearAll(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!currentShow())
+    {
+        return;
+    }
+
+    currentShow()->clearAll();
+}
+
+void ClientConnection::sendGraphicsCleared(int channel, const QString &group, const QStringList &graphics)
 {
+    QJsonObject object;
+
+    if(!group.isEmpty())
+    {
+        object.insert("group", group);
+    }
+
+    object.insert("graphics", QJsonArray::fromStringList(graphics));
+
+    sendCommand("graphics cleared", object, channel);
+}
+
+void ClientConnection::sendGraphicCued(int channel, const QString &graphic, bool ready)
+{
+    QJsonObject object;
+    object.insert("graphic", graphic);
+    object.insert("ready", ready);
+
+    sendCommand("cued", object, channel);
+}
+
+void ClientConnection::sendGraphicStateChanged(int channel, const QString &graphic, int state)
+{
+    Graphic::State graphicState = Graphic::State(state);
+
     QJsonObject object;
     object.insert("graphic", graphic);
-    object.insert("state", state);
+    object.insert("state", graphicState == Graphic::OnAirState || graphicState == Graphic::TransitioningInState);
+    object.insert("phase", Graphic::stateName(graphicState));
 
-    sendCommand("graphic state changed", object);
+    sendCommand("graphic state changed", object, channel);
 }
 
 void ClientConnection::parseListTemplates(const QJsonValue &data)
@@ -150,9 +277,55 @@ void ClientConnection::parseListTemplates(const QJsonValue &data)
     sendCommand("templates", QJsonArray::fromStringList(templates));
 }
 
+static QJsonObject indexEntryToJson(const DirectoryIndex::Entry &entry)
+{
+    QJsonObject object;
+    object.insert("Name", entry.name);
+    object.insert("Size", double(entry.size));
+    object.insert("Modified", entry.modified.toString(Qt::ISODate));
+
+    return object;
+}
+
+void ClientConnection::parseGetTemplateIndex(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    TemplateCache *cache = m_server->mainWindow()->templateCache();
+    QJsonArray array;
+
+    foreach(const DirectoryIndex::Entry &entry, m_server->mainWindow()->templateIndex()->entries())
+    {
+        QJsonObject object = indexEntryToJson(entry);
+
+        // Only known for templates that have been compiled
+        QSharedPointer<const TemplateSchema> schema = cache->schema(entry.canonicalPath);
+
+        if(schema)
+        {
+            QJsonArray properties;
+
+            foreach(const TemplateSchema::Property &property, schema->properties())
+            {
+                QJsonObject propertyObject;
+                propertyObject.insert("Name", QString(property.name));
+                propertyObject.insert("Type", QString(property.typeName));
+                propertyObject.insert("Default", QJsonValue::fromVariant(property.defaultValue));
+                properties.append(propertyObject);
+            }
+
+            object.insert("Properties", properties);
+        }
+
+        array.append(object);
+    }
+
+    sendCommand("template index", array);
+}
+
 void ClientConnection::parseCreateGraphic(const QJsonValue &data)
 {
-    if(!m_server->mainWindow()->currentShow())
+    if(!currentShow())
     {
         return;
     }
@@ -174,19 +347,19 @@ void ClientConnection::parseCreateGraphic(const QJsonValue &data)
         return;
     }
 
-    m_server->mainWindow()->currentShow()->createGraphic(name, templateName);
-    m_server->sendGraphicAdded(name);
+    currentShow()->createGraphic(name, templateName);
+    m_server->sendGraphicAdded(m_channel->id(), name);
 }
 
 void ClientConnection::parseGetProperties(const QJsonValue &data)
 {
-    if(!m_server->mainWindow()->currentShow())
+    if(!currentShow())
     {
         return;
     }
 
     QString graphicName = data.toString();
-    Graphic* graphic = m_server->mainWindow()->currentShow()->graphicFromName(graphicName);
+    Graphic* graphic = currentShow()->graphicFromName(graphicName);
 
     if(graphic)
     {
@@ -195,27 +368,38 @@ void ClientConnection::parseGetProperties(const QJsonValue &data)
         object.insert("OnAirTimerEnabled", graphic->onAirTimerEnabled());
         object.insert("OnAirTimerInterval", graphic->onAirTimerInterval());
         object.insert("Group", graphic->group());
+        object.insert("State", Graphic::stateName(graphic->state()));
 
         QList<QPair<QString, QVariant> > propertyList = graphic->properties();
+        QList<TemplateSchema::Property> schema = graphic->schema() ? graphic->schema()->properties() : QList<TemplateSchema::Property>();
         QJsonArray array;
 
+        // properties() follows the schema order
         for(int i = 0; i < propertyList.count(); ++i)
         {
             QJsonObject propertyObject;
             propertyObject.insert("Name", propertyList.at(i).first);
             propertyObject.insert("Value", QJsonValue::fromVariant(propertyList.at(i).second));
+
+            // Without a schema there are only the values that were set
+            if(i < schema.count())
+            {
+                propertyObject.insert("Type", QString(schema.at(i).typeName));
+                propertyObject.insert("Default", QJsonValue::fromVariant(schema.at(i).defaultValue));
+            }
+
             array.append(propertyObject);
         }
 
         object.insert("Properties", array);
 
-        sendCommand("graphic properties", object);
+        sendCommand("graphic properties", object, m_channel->id());
     }
 }
 
 void ClientConnection::parseSetGraphicProperties(const QJsonValue &data)
 {
-    if(!m_server->mainWindow()->currentShow())
+    if(!currentShow())
     {
         return;
     }
@@ -228,7 +412,7 @@ void ClientConnection::parseSetGraphicProperties(const QJsonValue &data)
 
     QJsonObject object = data.toObject();
     QString graphicName = object.value("Name").toString();
-    Graphic* graphic = m_server->mainWindow()->currentShow()->graphicFromName(graphicName);
+    Graphic* graphic = currentShow()->graphicFromName(graphicName);
 
     if(graphic)
     {
@@ -245,6 +429,349 @@ void ClientConnection::parseSetGraphicProperties(const QJsonValue &data)
     }
 }
 
+void ClientConnection::parseTransaction(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    if(!data.isObject())
+    {
+        qDebug() << "Transaction data is not a JSON object";
+        return;
+    }
+
+    QJsonObject object = data.toObject();
+    QList<Show::GraphicUpdate> updates;
+
+    foreach(const QJsonValue &value, object.value("Graphics").toArray())
+    {
+        QJsonObject graphicObject = value.toObject();
+
+        Show::GraphicUpdate update;
+        update.graphic = graphicObject.value("Name").toString();
+
+        foreach(const QJsonValue &property, graphicObject.value("Properties").toArray())
+        {
+            QJsonObject propertyObject = property.toObject();
+            update.properties.append(QPair<QByteArray, QVariant>(propertyObject.value("Name").toString().toLocal8Bit(),
+                                                                 propertyObject.value("Value").toVariant()));
+        }
+
+        // Optional, takes the graphic on or off air in the same frame
+        if(graphicObject.contains("OnAir"))
+        {
+            update.changeState = true;
+            update.onAir = graphicObject.value("OnAir").toBool();
+        }
+
+        updates.append(update);
+    }
+
+    QStringList missing;
+
+    QJsonObject reply;
+    reply.insert("Id", object.value("Id"));
+    reply.insert("Committed", currentShow()->commitTransaction(updates, &missing));
+
+    if(!missing.isEmpty())
+    {
+        qDebug() << "Transaction rejected, the show has no graphics called" << missing;
+        reply.insert("Missing", QJsonArray::fromStringList(missing));
+    }
+
+    sendCommand("transaction", reply, m_channel->id());
+}
+
+void ClientConnection::parseGetRundown(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!currentShow())
+    {
+        return;
+    }
+
+    QJsonArray array;
+
+    foreach(const Rundown::Action &action, currentShow()->rundown()->actions())
+    {
+        QJsonObject object;
+        object.insert("Time", double(action.time));
+        object.insert("Action", Rundown::typeName(action.type));
+
+        if(!action.graphic.isEmpty())
+        {
+            object.insert("Graphic", action.graphic);
+        }
+
+        if(!action.group.isEmpty())
+        {
+            object.insert("Group", action.group);
+        }
+
+        if(!action.properties.isEmpty())
+        {
+            QJsonArray properties;
+
+            for(int i = 0; i < action.properties.count(); ++i)
+            {
+                QJsonObject property;
+                property.insert("Name", QString(action.properties.at(i).first));
+                property.insert("Value", QJsonValue::fromVariant(action.properties.at(i).second));
+                properties.append(property);
+            }
+
+            object.insert("Properties", properties);
+        }
+
+        array.append(object);
+    }
+
+    sendCommand("rundown", array, m_channel->id());
+}
+
+void ClientConnection::parseSetRundown(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    if(!data.isArray())
+    {
+        qDebug() << "Rundown data is not a JSON array";
+        return;
+    }
+
+    QList<Rundown::Action> actions;
+
+    foreach(const QJsonValue &value, data.toArray())
+    {
+        QJsonObject object = value.toObject();
+
+        Rundown::Action action;
+        action.time = qint64(object.value("Time").toDouble());
+        action.graphic = object.value("Graphic").toString();
+        action.group = object.value("Group").toString();
+
+        if(!Rundown::typeFromName(object.value("Action").toString(), &action.type))
+        {
+            qDebug() << "Invalid rundown action" << object.value("Action").toString();
+            return;
+        }
+
+        foreach(const QJsonValue &property, object.value("Properties").toArray())
+        {
+            QJsonObject propertyObject = property.toObject();
+            action.properties.append(QPair<QByteArray, QVariant>(propertyObject.value("Name").toString().toLocal8Bit(),
+                                                                 propertyObject.value("Value").toVariant()));
+        }
+
+        actions.append(action);
+    }
+
+    currentShow()->rundown()->setActions(actions);
+}
+
+void ClientConnection::parseArmRundown(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    // Optionally starts part way through, in ms
+    currentShow()->rundown()->arm(qint64(data.toObject().value("From").toDouble()));
+}
+
+void ClientConnection::parsePauseRundown(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!currentShow())
+    {
+        return;
+    }
+
+    currentShow()->rundown()->pause();
+}
+
+void ClientConnection::parseResumeRundown(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!currentShow())
+    {
+        return;
+    }
+
+    currentShow()->rundown()->resume();
+}
+
+void ClientConnection::parseStopRundown(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!currentShow())
+    {
+        return;
+    }
+
+    currentShow()->rundown()->stop();
+}
+
+void ClientConnection::parseGetRundownStatus(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!m_channel)
+    {
+        return;
+    }
+
+    sendRundownStatus(m_channel->id());
+}
+
+void ClientConnection::sendRundownStatus(int channel)
+{
+    Channel *target = m_server->mainWindow()->channel(channel);
+
+    if(!target || !target->currentShow())
+    {
+        return;
+    }
+
+    Rundown *rundown = target->currentShow()->rundown();
+
+    QJsonObject jitter;
+    jitter.insert("Last", rundown->lastJitter());
+    jitter.insert("Max", rundown->maxJitter());
+    jitter.insert("Mean", rundown->meanJitter());
+
+    QJsonObject object;
+    object.insert("State", Rundown::stateName(rundown->state()));
+    object.insert("Position", double(rundown->position()));
+    object.insert("Next", rundown->nextAction());
+    object.insert("Executed", rundown->executedActions());
+    object.insert("Late", rundown->lateActions());
+    object.insert("Jitter", jitter);
+
+    sendCommand("rundown status", object, channel);
+}
+
+void ClientConnection::parseListFeeds(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    QJsonArray array;
+
+    foreach(DataFeed *feed, m_server->mainWindow()->feeds())
+    {
+        QJsonObject object;
+        object.insert("Name", feed->name());
+        object.insert("Type", DataFeed::typeName(feed->type()));
+        object.insert("Path", feed->path());
+        object.insert("Open", feed->isOpen());
+        object.insert("Fields", QJsonArray::fromStringList(feed->fields()));
+        object.insert("Updates", double(feed->updateCount()));
+        array.append(object);
+    }
+
+    sendCommand("feeds", array);
+}
+
+void ClientConnection::parseAddFeed(const QJsonValue &data)
+{
+    QJsonObject object = data.toObject();
+    QString name = object.value("Name").toString();
+    QString path = object.value("Path").toString();
+    DataFeed::Type type;
+
+    if(name.isEmpty() || path.isEmpty() || !DataFeed::typeFromName(object.value("Type").toString(), &type))
+    {
+        qDebug() << "Invalid add feed command";
+        return;
+    }
+
+    if(!m_server->mainWindow()->addFeed(new DataFeed(name, type, path)))
+    {
+        qDebug() << "Failed to open feed" << name;
+        return;
+    }
+
+    parseListFeeds(QJsonValue());
+}
+
+void ClientConnection::parseRemoveFeed(const QJsonValue &data)
+{
+    m_server->mainWindow()->removeFeed(data.toString());
+
+    parseListFeeds(QJsonValue());
+}
+
+void ClientConnection::parseGetFeedBindings(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    if(!currentShow())
+    {
+        return;
+    }
+
+    QJsonArray array;
+
+    foreach(const Show::FeedBinding &binding, currentShow()->feedBindings())
+    {
+        QJsonObject object;
+        object.insert("Feed", binding.feed);
+        object.insert("Field", binding.field);
+        object.insert("Graphic", binding.graphic);
+        object.insert("Property", QString(binding.property));
+        array.append(object);
+    }
+
+    sendCommand("feed bindings", array, m_channel->id());
+}
+
+void ClientConnection::parseSetFeedBindings(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    if(!data.isArray())
+    {
+        qDebug() << "Feed bindings data is not a JSON array";
+        return;
+    }
+
+    QList<Show::FeedBinding> bindings;
+
+    foreach(const QJsonValue &value, data.toArray())
+    {
+        QJsonObject object = value.toObject();
+
+        Show::FeedBinding binding;
+        binding.feed = object.value("Feed").toString();
+        binding.field = object.value("Field").toString();
+        binding.graphic = object.value("Graphic").toString();
+        binding.property = object.value("Property").toString().toLocal8Bit();
+
+        if(binding.feed.isEmpty() || binding.field.isEmpty() || binding.graphic.isEmpty() || binding.property.isEmpty())
+        {
+            qDebug() << "Invalid feed binding";
+            return;
+        }
+
+        bindings.append(binding);
+    }
+
+    currentShow()->setFeedBindings(bindings);
+}
+
 void ClientConnection::parseRemoveGraphic(const QJsonValue &data)
 {
     QString graphic = data.toString();
@@ -255,57 +782,82 @@ void ClientConnection::parseRemoveGraphic(const QJsonValue &data)
         return;
     }
 
-    if(!m_server->mainWindow()->currentShow())
+    if(!currentShow())
     {
         return;
     }
 
-    m_server->mainWindow()->currentShow()->removeGraphic(graphic);
-    m_server->sendGraphicRemoved(graphic);
+    currentShow()->removeGraphic(graphic);
+    m_server->sendGraphicRemoved(m_channel->id(), graphic);
+}
+
+void ClientConnection::sendGraphicAdded(int channel, const QString &graphic)
+{
+    sendCommand("graphic added", graphic, channel);
 }
 
-void ClientConnection::sendGraphicAdded(const QString &graphic)
+void ClientConnection::sendGraphicRemoved(int channel, const QString &graphic)
 {
-    sendCommand("graphic added", graphic);
+    sendCommand("graphic removed", graphic, channel);
 }
 
-void ClientConnection::sendGraphicRemoved(const QString &graphic)
+void ClientConnection::sendShowLoadProgress(int channel, const QString &show, int loaded, int total)
 {
-    sendCommand("graphic removed", graphic);
+    QJsonObject object;
+    object.insert("Show", show);
+    object.insert("Loaded", loaded);
+    object.insert("Total", total);
+
+    sendCommand("show load progress", object, channel);
 }
 
 void ClientConnection::parseListShows(const QJsonValue &data)
 {
     Q_UNUSED(data)
 
-    sendShowList();
+    sendShowList(m_channel->id());
+}
+
+void ClientConnection::parseGetShowIndex(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    QJsonArray array;
+
+    foreach(const DirectoryIndex::Entry &entry, m_server->mainWindow()->showIndex()->entries())
+    {
+        array.append(indexEntryToJson(entry));
+    }
+
+    sendCommand("show index", array);
 }
 
 void ClientConnection::parseCreateShow(const QJsonValue &data)
 {
     QString showName = data.toString();
-    m_server->mainWindow()->createShow(showName);
+    m_server->mainWindow()->createShow(showName, m_channel);
 }
 
-void ClientConnection::sendShowList()
+void ClientConnection::sendShowList(int channel)
 {
     QJsonObject object;
+    Channel *showChannel = m_server->mainWindow()->channel(channel);
 
-    if(m_server->mainWindow()->currentShow())
+    if(showChannel && showChannel->currentShow())
     {
-        object.insert("current", m_server->mainWindow()->currentShow()->showName());
+        object.insert("current", showChannel->currentShow()->showName());
     }
 
     QStringList shows = m_server->mainWindow()->shows();
     object.insert("shows", QJsonArray::fromStringList(shows));
 
-    sendCommand("shows", object);
+    sendCommand("shows", object, channel);
 }
 
 void ClientConnection::parseChangeCurrentShow(const QJsonValue &data)
 {
     QString showName = data.toString();
-    m_server->mainWindow()->setCurrentShow(showName);
+    m_channel->setCurrentShow(showName);
 }
 
 void ClientConnection::parseRemoveShow(const QJsonValue &data)
@@ -313,3 +865,199 @@ void ClientConnection::parseRemoveShow(const QJsonValue &data)
     QString showName = data.toString();
     m_server->mainWindow()->removeShow(showName);
 }
+
+void ClientConnection::parseGetFrameStats(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    FrameClock *clock = m_server->mainWindow()->frameClock();
+
+    QJsonObject object;
+    object.insert("FrameRate", clock->frameRate());
+    object.insert("Produced", double(clock->producedFrames()));
+    object.insert("Late", double(clock->lateFrames()));
+    object.insert("Dropped", double(clock->droppedFrames()));
+    object.insert("Repeated", double(clock->repeatedFrames()));
+
+    // Frames a channel's renderer was still busy with when the next tick came
+    QJsonArray channels;
+
+    foreach(Channel *channel, m_server->mainWindow()->channels())
+    {
+        QJsonObject channelObject;
+        channelObject.insert("Channel", channel->id());
+        channelObject.insert("LateRenders", double(channel->renderer()->stats()->lateFrames()));
+        channels.append(channelObject);
+    }
+
+    object.insert("Channels", channels);
+
+    sendCommand("frame stats", object);
+}
+
+void ClientConnection::parseStartRecording(const QJsonValue &data)
+{
+    QJsonObject object = data.toObject();
+    QString format = object.value("Format").toString("avi");
+    QString name = object.value("Name").toString();
+
+    if(!m_server->mainWindow()->startRecording(m_channel, format, name))
+    {
+        qDebug() << "Failed to start recording";
+        return;
+    }
+
+    m_server->sendRecordingStarted(m_server->mainWindow()->recorder()->path());
+}
+
+void ClientConnection::parseStopRecording(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    m_server->mainWindow()->stopRecording();
+}
+
+void ClientConnection::sendRecordingStarted(const QString &path)
+{
+    sendCommand("recording started", path);
+}
+
+void ClientConnection::sendRecordingOverflow(quint64 framesDropped)
+{
+    sendCommand("recording overflow", double(framesDropped));
+}
+
+void ClientConnection::sendRecordingFinished(const QString &path, quint64 framesWritten, quint64 framesDropped)
+{
+    QJsonObject object;
+    object.insert("Path", path);
+    object.insert("Written", double(framesWritten));
+    object.insert("Dropped", double(framesDropped));
+
+    sendCommand("recording finished", object);
+}
+
+void ClientConnection::parseGetCacheStats(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    TemplateCache *cache = m_server->mainWindow()->templateCache();
+
+    QJsonObject templates;
+    templates.insert("Hits", double(cache->hits()));
+    templates.insert("Misses", double(cache->misses()));
+    templates.insert("Cached", cache->templateCount());
+
+    QJsonObject object;
+    object.insert("Templates", templates);
+
+    Show *show = currentShow();
+
+    if(show)
+    {
+        QJsonObject items;
+        items.insert("Hits", double(show->cacheHits()));
+        items.insert("Misses", double(show->cacheMisses()));
+        items.insert("Cached", show->cachedGraphicCount());
+        items.insert("Materialized", show->materializedGraphicCount());
+        items.insert("MemoryEstimate", double(show->itemMemoryEstimate()));
+
+        object.insert("Items", items);
+    }
+
+    sendCommand("cache stats", object, m_channel->id());
+}
+
+void ClientConnection::parseGetRenderStats(const QJsonValue &data)
+{
+    Q_UNUSED(data)
+
+    RenderStats *stats = m_channel->renderer()->stats();
+    FrameClock *clock = m_server->mainWindow()->frameClock();
+
+    QJsonObject frameTime;
+    frameTime.insert("P50", stats->frameTimePercentile(50));
+    frameTime.insert("P90", stats->frameTimePercentile(90));
+    frameTime.insert("P99", stats->frameTimePercentile(99));
+    frameTime.insert("Max", stats->maxFrameTime());
+    frameTime.insert("Mean", stats->meanFrameTime());
+    frameTime.insert("Budget", clock->frameDuration() / 1000000.0);
+
+    QJsonObject items;
+    items.insert("Last", stats->lastPaintedItems());
+    items.insert("Max", stats->maxPaintedItems());
+    items.insert("Mean", stats->meanPaintedItems());
+
+    QJsonObject frames;
+    frames.insert("Rendered", double(stats->renderedFrames()));
+    frames.insert("Produced", double(clock->producedFrames()));
+    frames.insert("Late", double(clock->lateFrames()));
+    frames.insert("LateRenders", double(stats->lateFrames()));
+    frames.insert("Dropped", double(clock->droppedFrames()));
+    frames.insert("Repeated", double(clock->repeatedFrames()));
+
+    QJsonObject object;
+    object.insert("FrameTime", frameTime);
+    object.insert("PaintedItems", items);
+    object.insert("Frames", frames);
+    object.insert("PropertyUpdates", double(stats->propertyUpdates()));
+    object.insert("StateChanges", double(stats->stateChanges()));
+
+    QJsonArray outputs;
+
+    foreach(ScaledOutput *output, m_channel->scaledOutputs())
+    {
+        QJsonObject outputObject;
+        outputObject.insert("Width", output->size().width());
+        outputObject.insert("Height", output->size().height());
+        outputObject.insert("ScaleTime", output->meanScaleTime());
+        outputObject.insert("Scaled", double(output->scaledFrames()));
+        outputObject.insert("Dropped", double(output->droppedFrames()));
+        outputs.append(outputObject);
+    }
+
+    object.insert("Outputs", outputs);
+
+    sendCommand("render stats", object, m_channel->id());
+}
+
+void ClientConnection::parseGetThumbnail(const QJsonValue &data)
+{
+    if(!currentShow())
+    {
+        return;
+    }
+
+    QString name = data.toString();
+    Graphic *graphic = currentShow()->graphicFromName(name);
+
+    if(!graphic)
+    {
+        return;
+    }
+
+    ThumbnailRenderer *renderer = m_server->mainWindow()->thumbnailRenderer();
+    quint64 revision = 0;
+    QByteArray image = renderer->thumbnail(m_channel->id(), name, &revision);
+
+    // Otherwise it is pushed to all clients once it has been rendered
+    if(!image.isEmpty() && revision == graphic->revision())
+    {
+        sendGraphicThumbnail(m_channel->id(), name, revision, image);
+    }
+    else
+    {
+        renderer->request(m_channel->id(), graphic);
+    }
+}
+
+void ClientConnection::sendGraphicThumbnail(int channel, const QString &graphic, quint64 revision, const QByteArray &image)
+{
+    QJsonObject object;
+    object.insert("graphic", graphic);
+    object.insert("revision", double(revision));
+    object.insert("format", QString("png"));
+    object.insert("image", QString::fromLatin1(image.toBase64()));
+
+    sendCommand("graphic thumbnail", object, channel);
+}
@@ -22,6 +22,8 @@
 #include <QJsonValue>
 
 class Server;
+class Channel;
+class Show;
 class QJsonDocument;
 
 class ClientConnection : public QObject
@@ -30,38 +32,84 @@ class ClientConnection : public QObject
 public:
     explicit ClientConnection(QTcpSocket *socket, Server *parent = 0);
 
-    void sendGraphicAdded(const QString &graphic);
-    void sendGraphicRemoved(const QString &graphic);
+    void sendGraphicAdded(int channel, const QString &graphic);
+    void sendGraphicRemoved(int channel, const QString &graphic);
 
-    void sendGraphicStateChanged(const QString &graphic, bool state);
+    void sendGraphicStateChanged(int channel, const QString &graphic, int state);
 
-    void sendShowList();
+    void sendGraphicCued(int channel, const QString &graphic, bool ready);
+    void sendGraphicsCleared(int channel, const QString &group, const QStringList &graphics);
+
+    void sendRundownStatus(int channel);
+
+    void sendShowList(int channel);
+    void sendShowLoadProgress(int channel, const QString &show, int loaded, int total);
+
+    void sendGraphicThumbnail(int channel, const QString &graphic, quint64 revision, const QByteArray &image);
+
+    void sendRecordingStarted(const QString &path);
+    void sendRecordingOverflow(quint64 framesDropped);
+    void sendRecordingFinished(const QString &path, quint64 framesWritten, quint64 framesDropped);
 
 protected slots:
     void readFromSocket();
 
     void parseListGraphics(const QJsonValue &data);
     void parseToggleState(const QJsonValue &data);
+    void parseCueGraphic(const QJsonValue &data);
+    void parseClearGroup(const QJsonValue &data);
+    void parseClearAll(const QJsonValue &data);
     void parseListTemplates(const QJsonValue &data);
+    void parseGetTemplateIndex(const QJsonValue &data);
     void parseCreateGraphic(const QJsonValue &data);
     void parseGetProperties(const QJsonValue &data);
     void parseSetGraphicProperties(const QJsonValue &data);
     void parseRemoveGraphic(const QJsonValue &data);
+    void parseTransaction(const QJsonValue &data);
+
+    void parseGetRundown(const QJsonValue &data);
+    void parseSetRundown(const QJsonValue &data);
+    void parseArmRundown(const QJsonValue &data);
+    void parsePauseRundown(const QJsonValue &data);
+    void parseResumeRundown(const QJsonValue &data);
+    void parseStopRundown(const QJsonValue &data);
+    void parseGetRundownStatus(const QJsonValue &data);
+
+    void parseListFeeds(const QJsonValue &data);
+    void parseAddFeed(const QJsonValue &data);
+    void parseRemoveFeed(const QJsonValue &data);
+    void parseGetFeedBindings(const QJsonValue &data);
+    void parseSetFeedBindings(const QJsonValue &data);
 
     void parseListShows(const QJsonValue &data);
+    void parseGetShowIndex(const QJsonValue &data);
     void parseCreateShow(const QJsonValue &data);
     void parseChangeCurrentShow(const QJsonValue &data);
     void parseRemoveShow(const QJsonValue &data);
 
+    void parseGetFrameStats(const QJsonValue &data);
+
+    void parseStartRecording(const QJsonValue &data);
+    void parseStopRecording(const QJsonValue &data);
+
+    void parseGetCacheStats(const QJsonValue &data);
+
+    void parseGetRenderStats(const QJsonValue &data);
+
+    void parseGetThumbnail(const QJsonValue &data);
+
 protected:
     void parseCommand(const QJsonDocument &jsonDoc);
-    void sendCommand(const QString &command, const QJsonValue &data = QJsonValue ());
+    void sendCommand(const QString &command, const QJsonValue &data = QJsonValue (), int channel = -1);
+
+    Show* currentShow() const;
 
     void initCommandHash();
 
 private:
     QPointer<QTcpSocket> m_socket;
     Server *m_server;
+    QPointer<Channel> m_channel;
 
     QHash<QString, QByteArray> m_commandHash;
 };
@@ -0,0 +1,476 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "datafeed.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+// Longer lines are dropped instead of buffered
+static const int MaxLineLength = 65536;
+
+DataFeed::DataFeed(const QString &name, Type type, const QString &path, QObject *parent) :
+    QObject(parent), m_name(name), m_type(type), m_path(path), m_open(false), m_serial(0), m_updateCount(0),
+    m_watcher(0), m_readTimer(0), m_pipeFd(-1), m_notifier(0), m_skipLine(false), m_server(0)
+{
+}
+
+DataFeed::~DataFeed()
+{
+    close();
+}
+
+QString DataFeed::typeName(Type type)
+{
+    switch(type)
+    {
+    case PipeFeed:
+        return "pipe";
+    case SocketFeed:
+        return "socket";
+    default:
+        return "file";
+    }
+}
+
+bool DataFeed::typeFromName(const QString &name, Type *type)
+{
+    QString lowerName = name.toLower();
+
+    if(lowerName == "file")
+    {
+        *type = FileFeed;
+    }
+    else if(lowerName == "pipe")
+    {
+        *type = PipeFeed;
+    }
+    else if(lowerName == "socket")
+    {
+        *type = SocketFeed;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool DataFeed::open()
+{
+    close();
+
+    switch(m_type)
+    {
+    case FileFeed:
+    {
+        m_watcher = new QFileSystemWatcher(this);
+        connect(m_watcher, SIGNAL(fileChanged(QString)),
+                this, SLOT(onFileChanged()));
+        connect(m_watcher, SIGNAL(directoryChanged(QString)),
+                this, SLOT(onDirectoryChanged()));
+
+        if(!m_watcher->addPath(m_path))
+        {
+            qDebug() << "Failed to watch the feed file" << m_path;
+            delete m_watcher;
+            m_watcher = 0;
+            return false;
+        }
+
+        // A file replaced by a rename drops out of the watcher, the
+        // directory tells when it is back
+        m_watcher->addPath(QFileInfo(m_path).absolutePath());
+
+        // Writers tend to save in several steps, and a fast feed would
+        // otherwise be parsed for every write
+        m_readTimer = new QTimer(this);
+        m_readTimer->setInterval(50);
+        m_readTimer->setSingleShot(true);
+        connect(m_readTimer, SIGNAL(timeout()),
+                this, SLOT(readFile()));
+
+        readFile();
+        break;
+    }
+    case PipeFeed:
+    {
+        QByteArray path = QFile::encodeName(m_path);
+
+        if(!QFileInfo(m_path).exists() && mkfifo(path.constData(), 0600) != 0)
+        {
+            qDebug() << "Failed to create the named pipe" << m_path << ":" << strerror(errno);
+            return false;
+        }
+
+        // Opened for writing as well, so the pipe doesn't hit end of file
+        // each time a writer goes away
+        m_pipeFd = ::open(path.constData(), O_RDWR | O_NONBLOCK);
+
+        if(m_pipeFd == -1)
+        {
+            qDebug() << "Failed to open the named pipe" << m_path << ":" << strerror(errno);
+            return false;
+        }
+
+        m_notifier = new QSocketNotifier(m_pipeFd, QSocketNotifier::Read, this);
+        connect(m_notifier, SIGNAL(activated(int)),
+                this, SLOT(readPipe()));
+        break;
+    }
+    case SocketFeed:
+    {
+        m_server = new QLocalServer(this);
+        connect(m_server, SIGNAL(newConnection()),
+                this, SLOT(acceptConnection()));
+
+        // A socket file left behind by a previous run would block listen()
+        QLocalServer::removeServer(m_path);
+
+        if(!m_server->listen(m_path))
+        {
+            qDebug() << "Failed to listen on" << m_path << ":" << m_server->errorString();
+            delete m_server;
+            m_server = 0;
+            return false;
+        }
+
+        break;
+    }
+    }
+
+    m_open = true;
+
+    return true;
+}
+
+void DataFeed::close()
+{
+    delete m_watcher;
+    m_watcher = 0;
+
+    delete m_readTimer;
+    m_readTimer = 0;
+
+    delete m_notifier;
+    m_notifier = 0;
+
+    if(m_pipeFd != -1)
+    {
+        ::close(m_pipeFd);
+        m_pipeFd = -1;
+    }
+
+    m_pipeBuffer.clear();
+    m_skipLine = false;
+
+    foreach(QLocalSocket *socket, m_connections)
+    {
+        delete socket;
+    }
+
+    m_connections.clear();
+
+    if(m_server)
+    {
+        m_server->close();
+        delete m_server;
+        m_server = 0;
+    }
+
+    m_open = false;
+}
+
+void DataFeed::onFileChanged()
+{
+    m_readTimer->start();
+}
+
+void DataFeed::onDirectoryChanged()
+{
+    if(!m_watcher->files().contains(m_path) && QFileInfo(m_path).exists())
+    {
+        m_readTimer->start();
+    }
+}
+
+void DataFeed::readFile()
+{
+    // Still being replaced, onDirectoryChanged() comes back once the new file is there
+    if(!QFileInfo(m_path).exists())
+    {
+        return;
+    }
+
+    if(!m_watcher->files().contains(m_path))
+    {
+        m_watcher->addPath(m_path);
+    }
+
+    QFile file(m_path);
+
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Failed to read the feed file" << m_path << ":" << file.errorString();
+        return;
+    }
+
+    ++m_updateCount;
+
+    if(m_path.endsWith(".json", Qt::CaseInsensitive))
+    {
+        parseJson(file.readAll());
+    }
+    else
+    {
+        parseCsv(file.readAll());
+    }
+}
+
+void DataFeed::readPipe()
+{
+    char buffer[4096];
+    ssize_t count;
+
+    while((count = ::read(m_pipeFd, buffer, sizeof(buffer))) > 0)
+    {
+        m_pipeBuffer.append(buffer, count);
+
+        int end;
+
+        while((end = m_pipeBuffer.indexOf('\n')) != -1)
+        {
+            // The rest of a line that was too long
+            if(!m_skipLine)
+            {
+                parseLine(m_pipeBuffer.left(end));
+            }
+
+            m_skipLine = false;
+            m_pipeBuffer.remove(0, end + 1);
+        }
+
+        // A writer that never ends its line must not grow the buffer forever
+        if(m_pipeBuffer.size() > MaxLineLength)
+        {
+            if(!m_skipLine)
+            {
+                qDebug() << "Feed" << m_name << "dropped a line longer than" << MaxLineLength << "bytes";
+            }
+
+            m_skipLine = true;
+            m_pipeBuffer.clear();
+        }
+    }
+}
+
+void DataFeed::acceptConnection()
+{
+    while(m_server->hasPendingConnections())
+    {
+        QLocalSocket *socket = m_server->nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()),
+                this, SLOT(readConnection()));
+        connect(socket, SIGNAL(disconnected()),
+                socket, SLOT(deleteLater()));
+        m_connections.append(socket);
+    }
+
+    m_connections.removeAll(QPointer<QLocalSocket>());
+}
+
+void DataFeed::readConnection()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+
+    if(!socket)
+    {
+        return;
+    }
+
+    while(socket->canReadLine())
+    {
+        parseLine(socket->readLine());
+    }
+
+    // A client that never ends its line must not grow the buffer forever
+    if(socket->bytesAvailable() > MaxLineLength)
+    {
+        qDebug() << "Feed" << m_name << "closed a connection sending a line longer than" << MaxLineLength << "bytes";
+        socket->abort();
+    }
+}
+
+void DataFeed::parseLine(const QByteArray &line)
+{
+    QByteArray trimmed = line.trimmed();
+
+    if(trimmed.isEmpty())
+    {
+        return;
+    }
+
+    ++m_updateCount;
+
+    if(trimmed.startsWith('{'))
+    {
+        parseJson(trimmed);
+        return;
+    }
+
+    int separator = trimmed.indexOf('=');
+
+    if(separator <= 0)
+    {
+        qDebug() << "Invalid line from feed" << m_name << ":" << trimmed;
+        return;
+    }
+
+    setValue(QString::fromUtf8(trimmed.left(separator).trimmed()), QString::fromUtf8(trimmed.mid(separator + 1).trimmed()));
+}
+
+void DataFeed::parseJson(const QByteArray &data)
+{
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+
+    if(!doc.isObject())
+    {
+        qDebug() << "Feed" << m_name << "did not get a JSON object:" << parseError.errorString();
+        return;
+    }
+
+    flattenObject(QString(), doc.object().toVariantMap());
+}
+
+void DataFeed::flattenObject(const QString &prefix, const QVariantMap &map)
+{
+    QVariantMap::const_iterator it;
+
+    for(it = map.constBegin(); it != map.constEnd(); ++it)
+    {
+        QString field = prefix.isEmpty() ? it.key() : prefix + "." + it.key();
+
+        if(it.value().type() == QVariant::Map)
+        {
+            flattenObject(field, it.value().toMap());
+        }
+        else
+        {
+            setValue(field, it.value());
+        }
+    }
+}
+
+static QStringList splitCsvLine(const QString &line)
+{
+    QStringList values;
+    QString value;
+    bool quoted = false;
+
+    for(int i = 0; i < line.length(); ++i)
+    {
+        QChar c = line.at(i);
+
+        if(quoted)
+        {
+            if(c == '"' && i + 1 < line.length() && line.at(i + 1) == '"')
+            {
+                value += c;
+                ++i;
+            }
+            else if(c == '"')
+            {
+                quoted = false;
+            }
+            else
+            {
+                value += c;
+            }
+        }
+        else if(c == '"')
+        {
+            quoted = true;
+        }
+        else if(c == ',')
+        {
+            values.append(value.trimmed());
+            value.clear();
+        }
+        else
+        {
+            value += c;
+        }
+    }
+
+    values.append(value.trimmed());
+
+    return values;
+}
+
+void DataFeed::parseCsv(const QByteArray &data)
+{
+    QStringList lines = QString::fromUtf8(data).split('\n', QString::SkipEmptyParts);
+
+    for(int i = lines.count() - 1; i >= 0; --i)
+    {
+        if(lines.at(i).trimmed().isEmpty())
+        {
+            lines.removeAt(i);
+        }
+    }
+
+    if(lines.count() < 2)
+    {
+        return;
+    }
+
+    QStringList fields = splitCsvLine(lines.first());
+    QStringList values = splitCsvLine(lines.last());
+
+    for(int i = 0; i < fields.count() && i < values.count(); ++i)
+    {
+        if(!fields.at(i).isEmpty())
+        {
+            setValue(fields.at(i), values.at(i));
+        }
+    }
+}
+
+void DataFeed::setValue(const QString &field, const QVariant &value)
+{
+    if(m_fieldSerials.contains(field) && m_values.value(field) == value)
+    {
+        return;
+    }
+
+    m_values.insert(field, value);
+    m_fieldSerials.insert(field, ++m_serial);
+}
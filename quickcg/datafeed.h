@@ -0,0 +1,115 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DATAFEED_H
+#define DATAFEED_H
+
+#include <QObject>
+#include <QHash>
+#include <QVariant>
+#include <QStringList>
+#include <QList>
+#include <QPointer>
+
+class QFileSystemWatcher;
+class QTimer;
+class QSocketNotifier;
+class QLocalServer;
+class QLocalSocket;
+
+// A local source of values for graphic properties. Only the latest value
+// of each field is kept, together with a serial number of the update that
+// last changed it. Applying the values is left to the frame loop, which
+// compares serials, so any number of updates between two frames cost one
+// property write.
+//
+// A file feed rereads the file shortly after it last changed. A .json file holds an
+// object, nested objects name their fields with dots. Other files are read
+// as CSV, the first line names the fields and the last line holds their
+// values. Pipe and socket feeds read lines, each either a JSON object or
+// field=value.
+class DataFeed : public QObject
+{
+    Q_OBJECT
+public:
+    enum Type
+    {
+        FileFeed,
+        PipeFeed,
+        SocketFeed
+    };
+
+    DataFeed(const QString &name, Type type, const QString &path, QObject *parent = 0);
+    ~DataFeed();
+
+    static QString typeName(Type type);
+    static bool typeFromName(const QString &name, Type *type);
+
+    QString name() const { return m_name; }
+    Type type() const { return m_type; }
+    QString path() const { return m_path; }
+
+    bool open();
+    void close();
+    bool isOpen() const { return m_open; }
+
+    QStringList fields() const { return m_values.keys(); }
+    QVariant value(const QString &field) const { return m_values.value(field); }
+
+    quint64 serial() const { return m_serial; }
+    quint64 fieldSerial(const QString &field) const { return m_fieldSerials.value(field); }
+
+    // Files read or lines received
+    quint64 updateCount() const { return m_updateCount; }
+
+protected slots:
+    void onFileChanged();
+    void onDirectoryChanged();
+    void readFile();
+    void readPipe();
+    void acceptConnection();
+    void readConnection();
+
+protected:
+    void parseJson(const QByteArray &data);
+    void parseCsv(const QByteArray &data);
+    void parseLine(const QByteArray &line);
+    void setValue(const QString &field, const QVariant &value);
+    void flattenObject(const QString &prefix, const QVariantMap &map);
+
+private:
+    QString m_name;
+    Type m_type;
+    QString m_path;
+    bool m_open;
+
+    QHash<QString, QVariant> m_values;
+    QHash<QString, quint64> m_fieldSerials;
+    quint64 m_serial;
+    quint64 m_updateCount;
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_readTimer;
+
+    int m_pipeFd;
+    QSocketNotifier *m_notifier;
+    QByteArray m_pipeBuffer;
+    bool m_skipLine;
+
+    QLocalServer *m_server;
+    QList<QPointer<QLocalSocket> > m_connections;
+};
+
+#endif // DATAFEED_H
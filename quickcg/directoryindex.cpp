@@ -0,0 +1,147 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "directoryindex.h"
+
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+static DirectoryIndex::Entry entryFromInfo(const QFileInfo &info)
+{
+    DirectoryIndex::Entry entry;
+    entry.name = info.fileName();
+    entry.canonicalPath = info.canonicalFilePath();
+    entry.size = info.size();
+    entry.modified = info.lastModified();
+
+    return entry;
+}
+
+// Runs on a worker thread
+static QMap<QString, DirectoryIndex::Entry> scanDirectory(const QString &path, const QStringList &nameFilters)
+{
+    QMap<QString, DirectoryIndex::Entry> entries;
+
+    foreach(const QFileInfo &info, QDir(path).entryInfoList(nameFilters, QDir::Files))
+    {
+        entries.insert(info.fileName(), entryFromInfo(info));
+    }
+
+    return entries;
+}
+
+static bool operator!=(const DirectoryIndex::Entry &a, const DirectoryIndex::Entry &b)
+{
+    return a.size != b.size || a.modified != b.modified || a.canonicalPath != b.canonicalPath;
+}
+
+DirectoryIndex::DirectoryIndex(const QDir &dir, const QStringList &nameFilters, QObject *parent) :
+    QObject(parent), m_dir(dir), m_nameFilters(nameFilters), m_scanning(false), m_rescan(false)
+{
+    m_watcher = new QFileSystemWatcher(this);
+    m_watcher->addPath(m_dir.absolutePath());
+    connect(m_watcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(startScan()));
+
+    // Copying many files in gives a burst of notifications
+    m_scanTimer = new QTimer(this);
+    m_scanTimer->setInterval(250);
+    m_scanTimer->setSingleShot(true);
+    connect(m_scanTimer, SIGNAL(timeout()),
+            this, SLOT(startScan()));
+
+    setEntries(scanDirectory(m_dir.absolutePath(), m_nameFilters));
+}
+
+void DirectoryIndex::update(const QString &name)
+{
+    QFileInfo info(m_dir.absoluteFilePath(name));
+
+    if(info.exists() && QDir::match(m_nameFilters, name))
+    {
+        QMap<QString, Entry> entries = m_entries;
+        entries.insert(name, entryFromInfo(info));
+        setEntries(entries);
+    }
+    else if(m_entries.contains(name))
+    {
+        QMap<QString, Entry> entries = m_entries;
+        entries.remove(name);
+        setEntries(entries);
+    }
+}
+
+void DirectoryIndex::startScan()
+{
+    if(sender() == m_watcher)
+    {
+        m_scanTimer->start();
+        return;
+    }
+
+    // Changes during a scan may have been missed, scan again afterwards
+    if(m_scanning)
+    {
+        m_rescan = true;
+        return;
+    }
+
+    m_scanning = true;
+
+    QFutureWatcher<QMap<QString, Entry> > *watcher = new QFutureWatcher<QMap<QString, Entry> >(this);
+    connect(watcher, SIGNAL(finished()),
+            this, SLOT(onScanFinished()));
+    watcher->setFuture(QtConcurrent::run(scanDirectory, m_dir.absolutePath(), m_nameFilters));
+}
+
+void DirectoryIndex::onScanFinished()
+{
+    QFutureWatcher<QMap<QString, Entry> > *watcher = static_cast<QFutureWatcher<QMap<QString, Entry> >*>(sender());
+    QMap<QString, Entry> entries = watcher->result();
+    watcher->deleteLater();
+
+    m_scanning = false;
+    setEntries(entries);
+
+    if(m_rescan)
+    {
+        m_rescan = false;
+        m_scanTimer->start();
+    }
+}
+
+void DirectoryIndex::setEntries(const QMap<QString, Entry> &entries)
+{
+    bool modified = entries.count() != m_entries.count();
+
+    for(QMap<QString, Entry>::const_iterator it = entries.constBegin(); !modified && it != entries.constEnd(); ++it)
+    {
+        QMap<QString, Entry>::const_iterator old = m_entries.constFind(it.key());
+        modified = old == m_entries.constEnd() || *old != *it;
+    }
+
+    if(!modified)
+    {
+        return;
+    }
+
+    m_entries = entries;
+    m_fileNames = m_entries.keys();
+
+    emit changed();
+}
@@ -0,0 +1,80 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DIRECTORYINDEX_H
+#define DIRECTORYINDEX_H
+
+#include <QObject>
+#include <QDir>
+#include <QMap>
+#include <QDateTime>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// The files in a directory that match the name filters, kept in memory
+// so listing them does not touch the disk. The directory is scanned once
+// when the index is created and again on a worker thread whenever the
+// watcher reports a change. Files written by the server itself can be
+// updated right away with update() instead of waiting for the watcher.
+class DirectoryIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry
+    {
+        QString name;
+        QString canonicalPath;
+        qint64 size;
+        QDateTime modified;
+    };
+
+    DirectoryIndex(const QDir &dir, const QStringList &nameFilters, QObject *parent = 0);
+
+    QDir dir() const { return m_dir; }
+
+    // Sorted by name
+    QStringList fileNames() const { return m_fileNames; }
+    QList<Entry> entries() const { return m_entries.values(); }
+    bool contains(const QString &name) const { return m_entries.contains(name); }
+    Entry entry(const QString &name) const { return m_entries.value(name); }
+
+    void update(const QString &name);
+
+protected slots:
+    void startScan();
+    void onScanFinished();
+
+protected:
+    void setEntries(const QMap<QString, Entry> &entries);
+
+private:
+    QDir m_dir;
+    QStringList m_nameFilters;
+
+    QMap<QString, Entry> m_entries;
+    QStringList m_fileNames;
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_scanTimer;
+    bool m_scanning;
+    bool m_rescan;
+
+signals:
+    void changed();
+};
+
+#endif // DIRECTORYINDEX_H
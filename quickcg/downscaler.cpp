@@ -0,0 +1,443 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "downscaler.h"
+
+#include <QImage>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define QUICKCG_HAVE_AVX2
+#endif
+
+// All kernels work on premultiplied ARGB32 and do the same integer
+// arithmetic so the vector versions match the scalar one bit for bit.
+// Blend weights are in 1/256 steps.
+
+static void halveScalar(const uchar *src, int srcStride, uchar *dst, int dstStride, int dstWidth, int dstHeight)
+{
+    for(int y = 0; y < dstHeight; ++y)
+    {
+        const uchar *row0 = src + 2 * y * srcStride;
+        const uchar *row1 = row0 + srcStride;
+        uchar *out = dst + y * dstStride;
+
+        for(int x = 0; x < dstWidth * 4; x += 4)
+        {
+            for(int c = 0; c < 4; ++c)
+            {
+                out[x + c] = (row0[2 * x + c] + row0[2 * x + 4 + c] + row1[2 * x + c] + row1[2 * x + 4 + c] + 2) >> 2;
+            }
+        }
+    }
+}
+
+static void blendRowsScalar(const uchar *row0, const uchar *row1, uchar *out, int bytes, int weight)
+{
+    const int inverse = 256 - weight;
+
+    for(int i = 0; i < bytes; ++i)
+    {
+        out[i] = (row0[i] * inverse + row1[i] * weight) >> 8;
+    }
+}
+
+static void blendColumnsScalar(const uchar *row, uchar *out, const int *offsets, const int *weights, int dstWidth)
+{
+    for(int x = 0; x < dstWidth; ++x)
+    {
+        const uchar *pixel = row + offsets[x];
+        const int weight = weights[x];
+        const int inverse = 256 - weight;
+
+        for(int c = 0; c < 4; ++c)
+        {
+            out[4 * x + c] = (pixel[c] * inverse + pixel[4 + c] * weight) >> 8;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+static void halveSse2(const uchar *src, int srcStride, uchar *dst, int dstStride, int dstWidth, int dstHeight)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+    const int vectorWidth = dstWidth & ~3;
+
+    for(int y = 0; y < dstHeight; ++y)
+    {
+        const uchar *row0 = src + 2 * y * srcStride;
+        const uchar *row1 = row0 + srcStride;
+        uchar *out = dst + y * dstStride;
+
+        for(int x = 0; x < vectorWidth; x += 4)
+        {
+            __m128i result[2];
+
+            for(int half = 0; half < 2; ++half)
+            {
+                // Two source pixels per output pixel, so 16 source bytes make two output pixels
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x + 16 * half));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x + 16 * half));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                result[half] = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), rounding), 2);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x), _mm_packus_epi16(result[0], result[1]));
+        }
+
+        if(vectorWidth < dstWidth)
+        {
+            halveScalar(row0 + 8 * vectorWidth, srcStride, out + 4 * vectorWidth, dstStride, dstWidth - vectorWidth, 1);
+        }
+    }
+}
+
+static void blendRowsSse2(const uchar *row0, const uchar *row1, uchar *out, int bytes, int weight)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weight1 = _mm_set1_epi16(weight);
+    const __m128i weight0 = _mm_set1_epi16(256 - weight);
+    const int vectorBytes = bytes & ~15;
+
+    for(int i = 0; i < vectorBytes; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), weight0),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), weight1));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), weight0),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), weight1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+
+    blendRowsScalar(row0 + vectorBytes, row1 + vectorBytes, out + vectorBytes, bytes - vectorBytes, weight);
+}
+
+static void blendColumnsSse2(const uchar *row, uchar *out, const int *offsets, const int *weights, int dstWidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    for(int x = 0; x < dstWidth; ++x)
+    {
+        const int weight = weights[x];
+        const __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + offsets[x])), zero);
+        const __m128i factors = _mm_set_epi16(weight, weight, weight, weight,
+                                              256 - weight, 256 - weight, 256 - weight, 256 - weight);
+        __m128i sum = _mm_mullo_epi16(pixels, factors);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_si128(sum, 8)), 8);
+        *reinterpret_cast<int*>(out + 4 * x) = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+    }
+}
+#endif
+
+#if defined(QUICKCG_HAVE_AVX2)
+__attribute__((target("avx2")))
+static void halveAvx2(const uchar *src, int srcStride, uchar *dst, int dstStride, int dstWidth, int dstHeight)
+{
+    const __m256i rounding = _mm256_set1_epi16(2);
+    const int vectorWidth = dstWidth & ~3;
+
+    for(int y = 0; y < dstHeight; ++y)
+    {
+        const uchar *row0 = src + 2 * y * srcStride;
+        const uchar *row1 = row0 + srcStride;
+        uchar *out = dst + y * dstStride;
+
+        for(int x = 0; x < vectorWidth; x += 4)
+        {
+            // Widen four source pixels at a time and add the rows, then the pixel pairs
+            __m256i a = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x))),
+                                         _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x))));
+            __m256i b = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x + 16))),
+                                         _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x + 16))));
+            a = _mm256_add_epi16(a, _mm256_permute4x64_epi64(a, _MM_SHUFFLE(2, 3, 0, 1)));
+            b = _mm256_add_epi16(b, _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m256i sums = _mm256_blend_epi32(_mm256_permute4x64_epi64(a, _MM_SHUFFLE(2, 0, 2, 0)),
+                                              _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 0, 2, 0)), 0xF0);
+            sums = _mm256_srli_epi16(_mm256_add_epi16(sums, rounding), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x),
+                             _mm_packus_epi16(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1)));
+        }
+
+        if(vectorWidth < dstWidth)
+        {
+            halveScalar(row0 + 8 * vectorWidth, srcStride, out + 4 * vectorWidth, dstStride, dstWidth - vectorWidth, 1);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void blendRowsAvx2(const uchar *row0, const uchar *row1, uchar *out, int bytes, int weight)
+{
+    const __m256i weight1 = _mm256_set1_epi16(weight);
+    const __m256i weight0 = _mm256_set1_epi16(256 - weight);
+    const int vectorBytes = bytes & ~15;
+
+    for(int i = 0; i < vectorBytes; i += 16)
+    {
+        const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i)));
+        const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i)));
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, weight0), _mm256_mullo_epi16(b, weight1));
+        sum = _mm256_srli_epi16(sum, 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+    }
+
+    blendRowsScalar(row0 + vectorBytes, row1 + vectorBytes, out + vectorBytes, bytes - vectorBytes, weight);
+}
+#endif
+
+typedef void (*HalveFunction)(const uchar*, int, uchar*, int, int, int);
+typedef void (*BlendRowsFunction)(const uchar*, const uchar*, uchar*, int, int);
+typedef void (*BlendColumnsFunction)(const uchar*, uchar*, const int*, const int*, int);
+
+struct Kernels
+{
+    HalveFunction halve;
+    BlendRowsFunction blendRows;
+    BlendColumnsFunction blendColumns;
+};
+
+static Kernels kernelsFor(Downscaler::Implementation implementation)
+{
+    Kernels kernels = { halveScalar, blendRowsScalar, blendColumnsScalar };
+
+#if defined(__SSE2__)
+    if(implementation != Downscaler::ScalarImplementation)
+    {
+        kernels.halve = halveSse2;
+        kernels.blendRows = blendRowsSse2;
+        kernels.blendColumns = blendColumnsSse2;
+    }
+#endif
+
+#if defined(QUICKCG_HAVE_AVX2)
+    // Columns are gathered one pixel at a time, wider registers don't help there
+    if(implementation == Downscaler::Avx2Implementation)
+    {
+        kernels.halve = halveAvx2;
+        kernels.blendRows = blendRowsAvx2;
+    }
+#endif
+
+    return kernels;
+}
+
+// Maps the centre of a target pixel to the two source pixels around it
+static void samplePosition(int position, int sourceLength, int targetLength, int *index, int *weight)
+{
+    qint64 fixed = ((2 * position + 1) * qint64(sourceLength) - targetLength) * 256 / (2 * targetLength);
+    fixed = qMax<qint64>(0, fixed);
+
+    *index = fixed >> 8;
+    *weight = fixed & 255;
+
+    if(*index >= sourceLength - 1)
+    {
+        *index = sourceLength - 2;
+        *weight = 256;
+    }
+}
+
+static void halveImage(const QImage &source, QImage *target, const Kernels &kernels)
+{
+    kernels.halve(source.constBits(), source.bytesPerLine(), target->bits(), target->bytesPerLine(),
+                  target->width(), target->height());
+}
+
+static void bilinearImage(const QImage &source, QImage *target, const Kernels &kernels)
+{
+    const int sourceWidth = source.width();
+    const int targetWidth = target->width();
+    QVector<int> offsets(targetWidth);
+    QVector<int> weights(targetWidth);
+
+    for(int x = 0; x < targetWidth; ++x)
+    {
+        int index;
+        samplePosition(x, sourceWidth, targetWidth, &index, &weights[x]);
+        offsets[x] = 4 * index;
+    }
+
+    QVector<uchar> row(4 * sourceWidth);
+
+    for(int y = 0; y < target->height(); ++y)
+    {
+        int index;
+        int weight;
+        samplePosition(y, source.height(), target->height(), &index, &weight);
+
+        kernels.blendRows(source.constScanLine(index), source.constScanLine(index + 1), row.data(), 4 * sourceWidth, weight);
+        kernels.blendColumns(row.constData(), target->scanLine(y), offsets.constData(), weights.constData(), targetWidth);
+    }
+}
+
+QList<Downscaler::Implementation> Downscaler::availableImplementations()
+{
+    QList<Implementation> implementations;
+    implementations << ScalarImplementation;
+
+#if defined(__SSE2__)
+    implementations << Sse2Implementation;
+#endif
+
+#if defined(QUICKCG_HAVE_AVX2)
+    if(__builtin_cpu_supports("avx2"))
+    {
+        implementations << Avx2Implementation;
+    }
+#endif
+
+    return implementations;
+}
+
+Downscaler::Implementation Downscaler::bestImplementation()
+{
+    static const Implementation best = availableImplementations().last();
+
+    return best;
+}
+
+QString Downscaler::implementationName(Implementation implementation)
+{
+    switch(implementation)
+    {
+    case Sse2Implementation:
+        return "SSE2";
+    case Avx2Implementation:
+        return "AVX2";
+    default:
+        return "Scalar";
+    }
+}
+
+void Downscaler::scale(const QImage &source, QImage *target)
+{
+    scale(source, target, bestImplementation());
+}
+
+void Downscaler::scale(const QImage &source, QImage *target, Implementation implementation)
+{
+    if(source.width() < 2 || source.height() < 2 || target->isNull())
+    {
+        *target = source.scaled(target->size()).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        return;
+    }
+
+    const Kernels kernels = kernelsFor(implementation);
+    QImage current = source;
+
+    if(current.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        current = current.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    // Halve first while the ratio allows it so bilinear never skips source pixels
+    while(current.width() >= 2 * target->width() && current.height() >= 2 * target->height())
+    {
+        if(current.width() / 2 == target->width() && current.height() / 2 == target->height())
+        {
+            halveImage(current, target, kernels);
+            return;
+        }
+
+        QImage half(current.width() / 2, current.height() / 2, QImage::Format_ARGB32_Premultiplied);
+        halveImage(current, &half, kernels);
+        current = half;
+    }
+
+    bilinearImage(current, target, kernels);
+}
+
+int Downscaler::benchmark(const QSize &sourceSize, const QList<QSize> &sizes, int iterations)
+{
+    QTextStream out(stdout);
+    QImage source(sourceSize, QImage::Format_ARGB32_Premultiplied);
+    quint32 seed = 1;
+
+    // Noise so no implementation gets an easy time on uniform input
+    for(int y = 0; y < source.height(); ++y)
+    {
+        uchar *line = source.scanLine(y);
+
+        for(int i = 0; i < source.bytesPerLine(); ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            line[i] = seed >> 24;
+        }
+    }
+
+    QList<QImage> references;
+
+    foreach(const QSize &size, sizes)
+    {
+        QImage reference(size, QImage::Format_ARGB32_Premultiplied);
+        scale(source, &reference, ScalarImplementation);
+        references.append(reference);
+    }
+
+    out << "Downscaling " << sourceSize.width() << "x" << sourceSize.height()
+        << ", " << iterations << " iterations per output\n";
+
+    int result = 0;
+
+    foreach(Implementation implementation, availableImplementations())
+    {
+        double total = 0;
+
+        out << implementationName(implementation) << ":\n";
+
+        for(int i = 0; i < sizes.count(); ++i)
+        {
+            QImage target(sizes.at(i), QImage::Format_ARGB32_Premultiplied);
+            scale(source, &target, implementation);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            for(int iteration = 0; iteration < iterations; ++iteration)
+            {
+                scale(source, &target, implementation);
+            }
+
+            double msecs = timer.nsecsElapsed() / 1000000.0 / iterations;
+            total += msecs;
+
+            out << "  " << sizes.at(i).width() << "x" << sizes.at(i).height() << ": "
+                << QString::number(msecs, 'f', 3) << " ms/frame";
+
+            if(target != references.at(i))
+            {
+                out << " (output differs from scalar)";
+                result = 1;
+            }
+
+            out << "\n";
+            out.flush();
+        }
+
+        out << "  all outputs: " << QString::number(total, 'f', 3) << " ms/frame\n";
+    }
+
+    return result;
+}
@@ -0,0 +1,51 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DOWNSCALER_H
+#define DOWNSCALER_H
+
+#include <QList>
+#include <QSize>
+#include <QString>
+
+class QImage;
+
+// Scales premultiplied ARGB32 frames down for secondary outputs. Exact
+// halvings use a 2x2 box filter, other sizes are halved while possible
+// and then bilinearly interpolated. The kernels use SSE2 or AVX2 when
+// the CPU has them and all implementations produce identical output.
+class Downscaler
+{
+public:
+    enum Implementation
+    {
+        ScalarImplementation,
+        Sse2Implementation,
+        Avx2Implementation
+    };
+
+    static QList<Implementation> availableImplementations();
+    static Implementation bestImplementation();
+    static QString implementationName(Implementation implementation);
+
+    // target has to be allocated with the output size and format
+    static void scale(const QImage &source, QImage *target);
+    static void scale(const QImage &source, QImage *target, Implementation implementation);
+
+    // Prints the cost per output size for each available implementation
+    static int benchmark(const QSize &sourceSize, const QList<QSize> &sizes, int iterations);
+};
+
+#endif // DOWNSCALER_H
@@ -0,0 +1,247 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "frameclock.h"
+
+#include <QTimer>
+#include <QStringList>
+
+#include <limits.h>
+
+static const qint64 NanosecondsPerSecond = 1000000000;
+
+FrameClock::FrameClock(QObject *parent) :
+    QObject(parent), m_numerator(25), m_denominator(1), m_running(false),
+    m_currentFrame(0), m_nextFrame(0)
+{
+    resetStatistics();
+
+    m_tickTimer = new QTimer(this);
+    m_tickTimer->setTimerType(Qt::PreciseTimer);
+    m_tickTimer->setSingleShot(true);
+    connect(m_tickTimer, SIGNAL(timeout()),
+            this, SLOT(processTick()));
+}
+
+bool FrameClock::parseFrameRate(const QString &text, int *numerator, int *denominator)
+{
+    // Accept both the NTSC style shorthands and explicit rationals like 60000/1001
+    if(text.contains('/'))
+    {
+        bool numOk = false;
+        bool denOk = false;
+        int num = text.section('/', 0, 0).toInt(&numOk);
+        int den = text.section('/', 1, 1).toInt(&denOk);
+
+        if(!numOk || !denOk || num <= 0 || den <= 0)
+        {
+            return false;
+        }
+
+        *numerator = num;
+        *denominator = den;
+        return true;
+    }
+
+    bool ok = false;
+    double rate = text.toDouble(&ok);
+
+    if(!ok || rate <= 0)
+    {
+        return false;
+    }
+
+    // 23.976, 29.97, 59.94 etc. stand for the exact n * 1000/1001 rates
+    static const int ntscRates[] = { 24, 30, 48, 60, 120 };
+
+    for(unsigned int i = 0; i < sizeof(ntscRates) / sizeof(ntscRates[0]); ++i)
+    {
+        if(qAbs(rate - ntscRates[i] * 1000.0 / 1001.0) < 0.005)
+        {
+            *numerator = ntscRates[i] * 1000;
+            *denominator = 1001;
+            return true;
+        }
+    }
+
+    // Anything else is taken exactly as written, 12.5 is 25/2
+    QString integerPart = text.trimmed().section('.', 0, 0);
+    QString fractionPart = text.trimmed().section('.', 1);
+
+    if(fractionPart.length() > 6)
+    {
+        return false;
+    }
+
+    qint64 den = 1;
+
+    for(int i = 0; i < fractionPart.length(); ++i)
+    {
+        den *= 10;
+    }
+
+    bool integerOk = false;
+    bool fractionOk = fractionPart.isEmpty();
+    qint64 num = integerPart.isEmpty() ? 0 : integerPart.toLongLong(&integerOk) * den;
+
+    if(integerPart.isEmpty())
+    {
+        integerOk = true;
+    }
+
+    if(!fractionPart.isEmpty())
+    {
+        num += fractionPart.toLongLong(&fractionOk);
+    }
+
+    if(!integerOk || !fractionOk || num <= 0)
+    {
+        return false;
+    }
+
+    qint64 a = num;
+    qint64 b = den;
+
+    while(b != 0)
+    {
+        qint64 remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+
+    num /= a;
+    den /= a;
+
+    if(num > INT_MAX)
+    {
+        return false;
+    }
+
+    *numerator = int(num);
+    *denominator = int(den);
+
+    return true;
+}
+
+void FrameClock::setFrameRate(int numerator, int denominator)
+{
+    if(numerator <= 0 || denominator <= 0)
+    {
+        return;
+    }
+
+    m_numerator = numerator;
+    m_denominator = denominator;
+
+    if(m_running)
+    {
+        stop();
+        start();
+    }
+}
+
+qint64 FrameClock::frameDuration() const
+{
+    return frameTime(1);
+}
+
+qint64 FrameClock::frameTime(quint64 frame) const
+{
+    // Split the multiplication to stay within 64 bits for long uptimes
+    const qint64 period = qint64(m_denominator) * NanosecondsPerSecond;
+
+    return qint64(frame / m_numerator) * period + qint64(frame % m_numerator) * period / m_numerator;
+}
+
+quint64 FrameClock::frameAt(qint64 nsecs) const
+{
+    const qint64 period = qint64(m_denominator) * NanosecondsPerSecond;
+
+    return quint64(nsecs / period) * m_numerator + quint64(nsecs % period) * m_numerator / period;
+}
+
+void FrameClock::resetStatistics()
+{
+    m_producedFrames = 0;
+    m_lateFrames = 0;
+    m_droppedFrames = 0;
+    m_repeatedFrames = 0;
+}
+
+void FrameClock::start()
+{
+    if(m_running)
+    {
+        return;
+    }
+
+    m_running = true;
+    m_currentFrame = 0;
+    m_nextFrame = 0;
+    m_clock.start();
+
+    m_tickTimer->start(0);
+}
+
+void FrameClock::stop()
+{
+    m_running = false;
+    m_tickTimer->stop();
+}
+
+void FrameClock::processTick()
+{
+    if(!m_running)
+    {
+        return;
+    }
+
+    const quint64 due = frameAt(m_clock.nsecsElapsed());
+
+    if(due < m_nextFrame)
+    {
+        // Timer fired early, it waits at least another millisecond
+        scheduleNextTick();
+        return;
+    }
+
+    if(due > m_nextFrame)
+    {
+        m_droppedFrames += due - m_nextFrame;
+    }
+
+    m_currentFrame = due;
+    m_nextFrame = due + 1;
+
+    emit tick(m_currentFrame);
+
+    ++m_producedFrames;
+
+    if(m_clock.nsecsElapsed() > frameTime(m_nextFrame))
+    {
+        ++m_lateFrames;
+    }
+
+    scheduleNextTick();
+}
+
+void FrameClock::scheduleNextTick()
+{
+    const qint64 remaining = frameTime(m_nextFrame) - m_clock.nsecsElapsed();
+
+    // Rounded up to the timer's millisecond resolution, so the tick lands
+    // up to 1 ms after the frame starts instead of spinning on start(0)
+    m_tickTimer->start(remaining > 0 ? int((remaining + 999999) / 1000000) : 0);
+}
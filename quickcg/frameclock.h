@@ -0,0 +1,89 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMECLOCK_H
+#define FRAMECLOCK_H
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QTimer;
+
+// Produces exactly one tick per output frame from the monotonic clock.
+// Ticks that could not be delivered in time are counted as dropped, and
+// ticks whose handlers ran past the start of the next frame as late.
+class FrameClock : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameClock(QObject *parent = 0);
+
+    static bool parseFrameRate(const QString &text, int *numerator, int *denominator);
+
+    void setFrameRate(int numerator, int denominator = 1);
+    int frameRateNumerator() const { return m_numerator; }
+    int frameRateDenominator() const { return m_denominator; }
+    double frameRate() const { return double(m_numerator) / m_denominator; }
+
+    qint64 frameDuration() const;
+    qint64 frameTime(quint64 frame) const;
+    // Nanoseconds since start(), on the same time base as frameTime()
+    qint64 elapsed() const { return m_clock.nsecsElapsed(); }
+
+    bool isRunning() const { return m_running; }
+    quint64 currentFrame() const { return m_currentFrame; }
+
+    quint64 producedFrames() const { return m_producedFrames; }
+    // Ticks that ran past the start of the next frame, late renders are counted per channel by RenderStats
+    quint64 lateFrames() const { return m_lateFrames; }
+    quint64 droppedFrames() const { return m_droppedFrames; }
+    quint64 repeatedFrames() const { return m_repeatedFrames; }
+
+    void resetStatistics();
+
+public slots:
+    void start();
+    void stop();
+
+    void countRepeatedFrame() { ++m_repeatedFrames; }
+
+protected slots:
+    void processTick();
+
+protected:
+    quint64 frameAt(qint64 nsecs) const;
+    void scheduleNextTick();
+
+private:
+    int m_numerator;
+    int m_denominator;
+
+    QElapsedTimer m_clock;
+    QTimer *m_tickTimer;
+    bool m_running;
+
+    quint64 m_currentFrame;
+    quint64 m_nextFrame;
+
+    quint64 m_producedFrames;
+    quint64 m_lateFrames;
+    quint64 m_droppedFrames;
+    quint64 m_repeatedFrames;
+
+signals:
+    void tick(quint64 frame);
+};
+
+#endif // FRAMECLOCK_H
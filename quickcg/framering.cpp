@@ -0,0 +1,190 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "framering.h"
+
+#include <QImage>
+#include <QDebug>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+static quint64 alignTo(quint64 value, quint64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static qint64 monotonicNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+FrameRing::FrameRing(QObject *parent) :
+    QObject(parent), m_header(0), m_mappedSize(0), m_framesWritten(0)
+{
+}
+
+FrameRing::~FrameRing()
+{
+    close();
+}
+
+bool FrameRing::open(const QString &name, const QSize &size, int slotCount)
+{
+    close();
+
+    if(name.isEmpty() || size.isEmpty() || slotCount < 2)
+    {
+        qDebug() << "Invalid frame ring parameters";
+        return false;
+    }
+
+    QByteArray shmName = name.toLocal8Bit();
+
+    if(!shmName.startsWith('/'))
+    {
+        shmName.prepend('/');
+    }
+
+    const quint64 stride = quint64(size.width()) * 4;
+    const quint64 pixelOffset = alignTo(sizeof(FrameRingSlot), 64);
+    const quint64 slotSize = alignTo(pixelOffset + stride * size.height(), 4096);
+    const quint64 dataOffset = alignTo(sizeof(FrameRingHeader), 4096);
+    const size_t mappedSize = dataOffset + slotSize * slotCount;
+
+    int fd = shm_open(shmName.constData(), O_CREAT | O_RDWR, 0644);
+
+    if(fd < 0)
+    {
+        qDebug() << "Failed to create shared memory" << shmName << ":" << strerror(errno);
+        return false;
+    }
+
+    if(ftruncate(fd, mappedSize) != 0)
+    {
+        qDebug() << "Failed to resize shared memory" << shmName << ":" << strerror(errno);
+        ::close(fd);
+        shm_unlink(shmName.constData());
+        return false;
+    }
+
+    void *memory = mmap(0, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(memory == MAP_FAILED)
+    {
+        qDebug() << "Failed to map shared memory" << shmName << ":" << strerror(errno);
+        shm_unlink(shmName.constData());
+        return false;
+    }
+
+    memset(memory, 0, dataOffset);
+
+    m_header = static_cast<FrameRingHeader*>(memory);
+    m_header->version = Version;
+    m_header->width = size.width();
+    m_header->height = size.height();
+    m_header->stride = stride;
+    m_header->slotCount = slotCount;
+    m_header->slotSize = slotSize;
+    m_header->dataOffset = dataOffset;
+    m_header->pixelOffset = pixelOffset;
+    m_header->lastFrame = 0;
+
+    for(int i = 0; i < slotCount; ++i)
+    {
+        FrameRingSlot *slot = reinterpret_cast<FrameRingSlot*>(static_cast<char*>(memory) + dataOffset + slotSize * i);
+        slot->sequence = 0;
+    }
+
+    // Publish the magic last so a consumer never sees a half initialized header
+    __atomic_store_n(&m_header->magic, Magic, __ATOMIC_RELEASE);
+
+    m_name = QString::fromLocal8Bit(shmName);
+    m_mappedSize = mappedSize;
+    m_framesWritten = 0;
+
+    return true;
+}
+
+void FrameRing::close()
+{
+    if(!m_header)
+    {
+        return;
+    }
+
+    munmap(m_header, m_mappedSize);
+    shm_unlink(m_name.toLocal8Bit().constData());
+
+    m_header = 0;
+    m_mappedSize = 0;
+    m_name.clear();
+}
+
+void FrameRing::writeFrame(const QImage &frame)
+{
+    if(!m_header)
+    {
+        return;
+    }
+
+    if(frame.width() != int(m_header->width) || frame.height() != int(m_header->height) ||
+            frame.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        qDebug() << "Frame does not match the format of frame ring" << m_name;
+        return;
+    }
+
+    const quint64 frameNumber = m_framesWritten + 1;
+    char *slotData = reinterpret_cast<char*>(m_header) + m_header->dataOffset +
+            m_header->slotSize * (frameNumber % m_header->slotCount);
+    FrameRingSlot *slot = reinterpret_cast<FrameRingSlot*>(slotData);
+    const quint64 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+
+    // Mark the slot as being written before touching the pixels
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uchar *pixels = reinterpret_cast<uchar*>(slotData + m_header->pixelOffset);
+
+    if(frame.bytesPerLine() == int(m_header->stride))
+    {
+        memcpy(pixels, frame.constBits(), size_t(m_header->stride) * m_header->height);
+    }
+    else
+    {
+        for(quint32 y = 0; y < m_header->height; ++y)
+        {
+            memcpy(pixels + y * m_header->stride, frame.constScanLine(y), m_header->stride);
+        }
+    }
+
+    slot->frameNumber = frameNumber;
+    slot->timestamp = monotonicNanoseconds();
+
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_header->lastFrame, frameNumber, __ATOMIC_RELEASE);
+
+    m_framesWritten = frameNumber;
+}
@@ -0,0 +1,88 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <QObject>
+#include <QSize>
+#include <QString>
+
+class QImage;
+
+// Layout of the POSIX shared memory object written by FrameRing. The
+// object starts with a FrameRingHeader, followed by slotCount slots of
+// slotSize bytes, the first one at dataOffset. Each slot begins with a
+// FrameRingSlot and has its premultiplied ARGB32 pixels at pixelOffset
+// from the start of the slot.
+//
+// There is a single writer and it never waits for readers. A slot's
+// sequence is odd while the writer is filling it, so a reader picks the
+// slot of header.lastFrame % slotCount, reads sequence, uses the pixels
+// in place and then reads sequence again. If the two values differ, or
+// the first one was odd, the writer lapped the reader and the frame has
+// to be discarded.
+struct FrameRingHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 width;
+    quint32 height;
+    quint32 stride;
+    quint32 slotCount;
+    quint64 slotSize;
+    quint64 dataOffset;
+    quint64 pixelOffset;
+    quint64 lastFrame;
+};
+
+struct FrameRingSlot
+{
+    quint64 sequence;
+    quint64 frameNumber;
+    qint64 timestamp; // CLOCK_MONOTONIC in nanoseconds
+};
+
+class FrameRing : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameRing(QObject *parent = 0);
+    ~FrameRing();
+
+    static const quint32 Magic = 0x46474351; // "QCGF"
+    static const quint32 Version = 1;
+
+    bool open(const QString &name, const QSize &size, int slotCount = 4);
+    void close();
+
+    bool isOpen() const { return m_header != 0; }
+    QString name() const { return m_name; }
+
+    quint64 framesWritten() const { return m_framesWritten; }
+
+public slots:
+    void writeFrame(const QImage &frame);
+
+private:
+    QString m_name;
+
+    FrameRingHeader *m_header;
+    size_t m_mappedSize;
+
+    quint64 m_framesWritten;
+};
+
+#endif // FRAMERING_H
@@ -0,0 +1,39 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMEVIEW_H
+#define FRAMEVIEW_H
+
+#include <QWidget>
+#include <QImage>
+
+// Shows the offscreen rendered program output keyed over green
+class FrameView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit FrameView(QWidget *parent = 0);
+
+public slots:
+    void setFrame(const QImage &frame);
+
+protected:
+    virtual void paintEvent(QPaintEvent *event);
+
+private:
+    QImage m_frame;
+};
+
+#endif // FRAMEVIEW_H
@@ -14,44 +14,90 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "graphic.h"
+#include "templateschema.h"
+#include "timerwheel.h"
 
-#include <QDeclarativeComponent>
-#include <QDeclarativeItem>
+#include <QQmlComponent>
+#include <QQuickItem>
+#include <QQmlProperty>
+#include <QQmlListReference>
+#include <QMetaProperty>
 #include <QDebug>
 
 Graphic::Graphic(const QString &name, QObject *parent) :
-    QObject(parent), m_name(name), m_component(0), m_item(0), m_onAirTimerEnabled(false)
+    QObject(parent), m_name(name), m_item(0), m_materializeRequested(false), m_itemFailed(false),
+    m_cueing(false), m_loadingImages(0), m_memoryEstimate(0),
+    m_state(OffAirState), m_itemOnAir(false), m_hasPendingOnAir(false), m_pendingOnAir(false),
+    m_timerWheel(0), m_onAirTimerId(0), m_onAirTimerInterval(10000), m_onAirTimerEnabled(false), m_cacheValid(false),
+    m_revision(0)
 {
-    m_onAirTimer = new QTimer(this);
-    m_onAirTimer->setInterval(10000);
-    m_onAirTimer->setSingleShot(true);
-    connect(m_onAirTimer, SIGNAL(timeout()),
-            this, SLOT(toggleOnAir()));
 }
 
 Graphic::~Graphic()
 {
-    delete m_component;
+    stopOnAirTimer();
+
     delete m_item;
 }
 
-void Graphic::setComponent(QDeclarativeComponent *component)
+void Graphic::setComponent(const QSharedPointer<QQmlComponent> &component)
 {
+    // The template is missing
     if(!component)
     {
+        failItem();
         return;
     }
 
+    if(m_component)
+    {
+        disconnect(m_component.data(), 0, this, 0);
+    }
+
     m_component = component;
+    m_itemFailed = false;
 
-    if(m_component->isReady())
+    if(m_component->isLoading())
     {
-        createItem();
+        QObject::connect(m_component.data(), SIGNAL(statusChanged(QQmlComponent::Status)),
+                         this, SLOT(onComponentStatusChanged()));
     }
     else
     {
-        QObject::connect(m_component, SIGNAL(statusChanged(QDeclarativeComponent::Status)),
-                         this, SLOT(createItem()));
+        onComponentStatusChanged();
+    }
+}
+
+void Graphic::onComponentStatusChanged()
+{
+    if(!m_component || m_component->isLoading())
+    {
+        return;
+    }
+
+    disconnect(m_component.data(), SIGNAL(statusChanged(QQmlComponent::Status)),
+               this, SLOT(onComponentStatusChanged()));
+
+    if(m_materializeRequested)
+    {
+        createItem();
+    }
+
+    // Previews are rendered from the component, the graphic doesn't need an item for one
+    if(m_component->isReady())
+    {
+        ++m_revision;
+        emit revisionChanged(this);
+    }
+}
+
+void Graphic::materialize()
+{
+    m_materializeRequested = true;
+
+    if(m_component && !m_component->isLoading())
+    {
+        createItem();
     }
 }
 
@@ -60,51 +106,584 @@ void Graphic::createItem()
     if(!m_component)
     {
         qDebug() << "createItem() failed, graphic" <<  m_name << "has no component!";
+        failItem();
+        return;
+    }
+
+    if(m_item)
+    {
+        return;
+    }
+
+    if(!m_component->isReady())
+    {
+        if(m_component->isError())
+        {
+            qDebug() << "createItem() failed, template for graphic" << m_name << "has errors:" << m_component->errors();
+        }
+
+        failItem();
         return;
     }
 
     QObject* object = m_component->create();
-    m_item = qobject_cast<QDeclarativeItem*>(object);
+    m_item = qobject_cast<QQuickItem*>(object);
+
+    if(!m_item)
+    {
+        qDebug() << "createItem() failed, template for graphic" << m_name << "is not a QtQuick item";
+        delete object;
+        failItem();
+        return;
+    }
+
+    QSharedPointer<const TemplateSchema> schema = verifiedSchema(m_schema, m_item);
+
+    if(schema != m_schema)
+    {
+        m_schema = schema;
+        emit schemaRebuilt(this);
+    }
+
     m_item->setProperty("state", "offAir"); // Ensure the item is in the offAir state after it's loaded
 
     for(int i = 0; i < m_tempPropertyList.count(); ++i)
     {
-        m_item->setProperty(m_tempPropertyList[i].first.toLocal8Bit(), m_tempPropertyList[i].second);
+        QByteArray name = m_tempPropertyList[i].first.toLatin1();
+        writeProperty(m_schema ? m_schema->propertyIndex(name) : -1, name, m_tempPropertyList[i].second);
     }
 
     m_tempPropertyList.clear();
 
+    initCache();
+    initState();
+
     emit itemCreated(m_item);
+    emit materialized(this);
+
+    if(m_cueing)
+    {
+        prepareItem();
+    }
+
+    // Changes requested before the item existed, e.g. taking it to air
+    if(hasPendingChanges())
+    {
+        emit changesPending(this);
+    }
+}
+
+void Graphic::cue()
+{
+    if(m_cueing)
+    {
+        return;
+    }
+
+    m_cueing = true;
+
+    if(m_item)
+    {
+        prepareItem();
+    }
+    else
+    {
+        materialize();
+
+        if(!m_item && m_itemFailed)
+        {
+            failCue();
+        }
+    }
+}
+
+// Image and AnimatedImage share QQuickImageBase and its status values
+static const int ImageLoading = 2;
+
+void Graphic::prepareItem()
+{
+    m_loadingImages = 0;
+    waitForImages(m_item);
+
+    // Text is laid out as its properties are set, glyphs and textures are
+    // uploaded by the frame the show renders before reporting the cue
+    if(m_loadingImages == 0)
+    {
+        m_cueing = false;
+        emit prepared(this, true);
+    }
+}
+
+void Graphic::failCue()
+{
+    // Otherwise the graphic would wait for its cue, and stay in memory, forever
+    if(m_cueing)
+    {
+        m_cueing = false;
+        emit prepared(this, false);
+    }
+}
+
+void Graphic::failItem()
+{
+    m_itemFailed = true;
+    failCue();
+
+    // A take that waited for the item never happens
+    if(m_hasPendingOnAir)
+    {
+        m_hasPendingOnAir = false;
+        emit stateChanged(m_name, OffAirState);
+    }
+}
+
+void Graphic::waitForImages(QQuickItem *item)
+{
+    if(item->inherits("QQuickImageBase") && item->property("status").toInt() == ImageLoading)
+    {
+        // Asynchronous images are decoded on a loader thread
+        const QMetaObject *metaObject = item->metaObject();
+        QMetaMethod notifySignal = metaObject->property(metaObject->indexOfProperty("status")).notifySignal();
+        QMetaMethod slot = staticMetaObject.method(staticMetaObject.indexOfSlot("onImageStatusChanged()"));
+
+        connect(item, notifySignal, this, slot);
+        ++m_loadingImages;
+    }
+
+    foreach(QQuickItem *child, item->childItems())
+    {
+        waitForImages(child);
+    }
+}
+
+void Graphic::onImageStatusChanged()
+{
+    QObject *image = sender();
+
+    if(!image || image->property("status").toInt() == ImageLoading)
+    {
+        return;
+    }
+
+    disconnect(image, 0, this, 0);
+
+    if(m_cueing && --m_loadingImages == 0)
+    {
+        m_cueing = false;
+        emit prepared(this, true);
+    }
+}
+
+bool Graphic::evict()
+{
+    // Also keeps graphics that are still transitioning out
+    if(!m_item || m_cueing || m_state != OffAirState || targetOnAir() || hasPendingChanges())
+    {
+        return false;
+    }
+
+    m_tempPropertyList = properties();
+
+    invalidateCache();
+    m_cachedItems.clear();
+    m_transitions.clear();
+    stopOnAirTimer();
+
+    delete m_item;
+    m_materializeRequested = false;
+    m_memoryEstimate = 0;
+
+    return true;
+}
+
+static int countItems(QQuickItem *item)
+{
+    int count = 1;
+
+    foreach(QQuickItem *child, item->childItems())
+    {
+        count += countItems(child);
+    }
+
+    return count;
+}
+
+// Find the subtrees that the template marked with "property bool cacheStatic: true"
+static void findStaticItems(QQuickItem *item, QList<QPointer<QQuickItem> > *list)
+{
+    foreach(QQuickItem *child, item->childItems())
+    {
+        if(child->property("cacheStatic").toBool())
+        {
+            list->append(child);
+        }
+        else
+        {
+            findStaticItems(child, list);
+        }
+    }
+}
+
+void Graphic::initCache()
+{
+    m_cachedItems.clear();
+    m_transitions.clear();
+
+    findStaticItems(m_item, &m_cachedItems);
+
+    if(m_cachedItems.isEmpty())
+    {
+        m_cachedItems.append(m_item);
+    }
+
+    // Guesswork, but items are cheap next to the textures of the cached layers
+    m_memoryEstimate = countItems(m_item) * 1024;
+
+    foreach(const QPointer<QQuickItem> &item, m_cachedItems)
+    {
+        m_memoryEstimate += qint64(item->width()) * qint64(item->height()) * 4;
+    }
+
+    // Animating a cached layer would rasterize it on every frame, so the
+    // layers are switched off while any of the state transitions run
+    QQmlListReference transitions(m_item, "transitions");
+
+    for(int i = 0; i < transitions.count(); ++i)
+    {
+        QObject *transition = transitions.at(i);
+        m_transitions.append(transition);
+        connect(transition, SIGNAL(runningChanged()),
+                this, SLOT(updateCache()));
+        connect(transition, SIGNAL(runningChanged()),
+                this, SLOT(updateState()));
+    }
+
+    updateCache();
+}
+
+void Graphic::initState()
+{
+    // The item's state is only read when it changes
+    connect(m_item, SIGNAL(stateChanged(QString)),
+            this, SLOT(onItemStateChanged(QString)));
+
+    m_itemOnAir = m_item->state() == "onAir";
+    updateState();
+}
+
+QString Graphic::stateName(State state)
+{
+    switch(state)
+    {
+    case TransitioningInState:
+        return "transitioningIn";
+    case OnAirState:
+        return "onAir";
+    case TransitioningOutState:
+        return "transitioningOut";
+    default:
+        return "offAir";
+    }
+}
+
+bool Graphic::transitionsRunning() const
+{
+    foreach(const QPointer<QObject> &transition, m_transitions)
+    {
+        if(transition && transition->property("running").toBool())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Graphic::onItemStateChanged(const QString &state)
+{
+    m_itemOnAir = state == "onAir";
+    updateState();
+}
+
+void Graphic::updateState()
+{
+    State state = OffAirState;
+
+    if(m_item)
+    {
+        bool running = transitionsRunning();
+
+        if(m_itemOnAir)
+        {
+            state = running ? TransitioningInState : OnAirState;
+        }
+        else
+        {
+            state = running ? TransitioningOutState : OffAirState;
+        }
+    }
+
+    if(state == m_state)
+    {
+        return;
+    }
+
+    m_state = state;
+    emit stateChanged(m_name, m_state);
+}
+
+void Graphic::setCacheLayersEnabled(bool enabled)
+{
+    foreach(const QPointer<QQuickItem> &item, m_cachedItems)
+    {
+        if(item)
+        {
+            QQmlProperty::write(item, "layer.enabled", enabled);
+        }
+    }
+}
+
+void Graphic::invalidateCache()
+{
+    if(!m_cacheValid)
+    {
+        return;
+    }
+
+    m_cacheValid = false;
+    emit cacheStateChanged(this, false);
+}
+
+void Graphic::updateCache()
+{
+    if(!m_item)
+    {
+        return;
+    }
+
+    if(transitionsRunning())
+    {
+        invalidateCache();
+        setCacheLayersEnabled(false);
+    }
+    else if(!m_cacheValid)
+    {
+        setCacheLayersEnabled(true);
+        m_cacheValid = true;
+        emit cacheStateChanged(this, true);
+    }
 }
 
 void Graphic::toggleOnAir()
 {
-    setOnAir(!isOnAir());
+    setOnAir(!targetOnAir());
 }
 
 void Graphic::setOnAir(bool state)
 {
     if(!m_item)
     {
+        // Taking a graphic off air that never went on air has nothing to do
+        if(!state && !m_hasPendingOnAir)
+        {
+            return;
+        }
+
+        materialize();
+
+        // Missing or broken template, the graphic can't go on air
+        if(!m_item && m_itemFailed)
+        {
+            emit stateChanged(m_name, OffAirState);
+            return;
+        }
+    }
+
+    // The state change is applied on the next frame boundary
+    m_pendingOnAir = state;
+    m_hasPendingOnAir = true;
+    emit changesPending(this);
+}
+
+void Graphic::reloadComponent(const QSharedPointer<QQmlComponent> &component, const QSharedPointer<const TemplateSchema> &schema)
+{
+    if(!component)
+    {
+        return;
+    }
+
+    // Nothing on screen, e.g. never used or the previous version had errors
+    if(!m_item)
+    {
+        m_schema = schema;
+        setComponent(component);
         return;
     }
 
+    m_pendingComponent = component;
+    m_pendingSchema = schema;
+    emit changesPending(this);
+}
+
+void Graphic::replaceItem()
+{
+    QSharedPointer<QQmlComponent> component = m_pendingComponent;
+    QSharedPointer<const TemplateSchema> schema = m_pendingSchema;
+    m_pendingComponent.clear();
+    m_pendingSchema.clear();
+
+    QObject *object = component->create();
+    QQuickItem *item = qobject_cast<QQuickItem*>(object);
+
+    if(!item)
+    {
+        qDebug() << "Reloading the template of graphic" << m_name << "failed:" << component->errors();
+        delete object;
+        return;
+    }
+
+    QSharedPointer<const TemplateSchema> verified = verifiedSchema(schema, item);
+    bool rebuilt = verified != schema;
+    schema = verified;
+
+    // Carry over the values of the properties the new version still has
+    QList<QPair<QString, QVariant> > values = properties();
+    const QMetaObject *metaObject = item->metaObject();
+
+    for(int i = 0; i < values.count(); ++i)
+    {
+        int index = schema ? schema->propertyIndex(values[i].first.toLatin1()) : -1;
+
+        if(index != -1)
+        {
+            metaObject->property(index).write(item, values[i].second);
+        }
+    }
+
+    // Go straight to the current state, the transitions into it already ran
+    QQmlListReference transitions(item, "transitions");
+    QList<QObject*> transitionList;
+
+    for(int i = 0; i < transitions.count(); ++i)
+    {
+        transitionList.append(transitions.at(i));
+    }
+
+    transitions.clear();
+    item->setProperty("state", isOnAir() ? "onAir" : "offAir");
+
+    foreach(QObject *transition, transitionList)
+    {
+        transitions.append(transition);
+    }
+
+    item->setParentItem(m_item->parentItem());
+    item->stackAfter(m_item);
+
+    invalidateCache();
+    delete m_item;
+
+    m_item = item;
+    m_component = component;
+    m_schema = schema;
+
+    if(rebuilt)
+    {
+        emit schemaRebuilt(this);
+    }
+
+    // Queued values were resolved against the previous version
+    for(int i = 0; i < m_pendingPropertyList.count(); ++i)
+    {
+        m_pendingPropertyList[i].index = m_schema ? m_schema->propertyIndex(m_pendingPropertyList[i].name) : -1;
+    }
+
+    initCache();
+    initState();
+
+    // The images of the replaced item are gone
+    if(m_cueing)
+    {
+        prepareItem();
+    }
+
+    ++m_revision;
+    emit revisionChanged(this);
+}
+
+// Stored schemas carry property indices, which move when a type the template
+// imports changes without the template itself changing
+QSharedPointer<const TemplateSchema> Graphic::verifiedSchema(const QSharedPointer<const TemplateSchema> &schema, QObject *object)
+{
+    if(!schema || schema->matches(object->metaObject()))
+    {
+        return schema;
+    }
+
+    qDebug() << "The property schema of graphic" << m_name << "is out of date, rebuilding it";
+
+    return QSharedPointer<const TemplateSchema>(TemplateSchema::fromObject(object));
+}
+
+bool Graphic::applyPendingChanges()
+{
+    if(!m_item || !hasPendingChanges())
+    {
+        return false;
+    }
+
+    if(m_pendingComponent)
+    {
+        replaceItem();
+    }
+
+    if(!m_pendingPropertyList.isEmpty())
+    {
+        // The cached layers get rasterized again with the new values
+        invalidateCache();
+
+        for(int i = 0; i < m_pendingPropertyList.count(); ++i)
+        {
+            const PendingProperty &property = m_pendingPropertyList.at(i);
+            writeProperty(property.index, property.name, property.value);
+        }
+
+        m_pendingPropertyList.clear();
+        ++m_revision;
+        emit revisionChanged(this);
+    }
+
+    if(m_hasPendingOnAir)
+    {
+        m_hasPendingOnAir = false;
+        invalidateCache();
+        applyOnAir(m_pendingOnAir);
+    }
+
+    updateCache();
+
+    return true;
+}
+
+void Graphic::applyOnAir(bool state)
+{
+    // The transitions start before the item reports its new state
+    m_itemOnAir = state;
+
     if(state)
     {
         m_item->setProperty("state", "onAir");
 
         if(m_onAirTimerEnabled)
         {
-            m_onAirTimer->start();
+            startOnAirTimer();
         }
     }
     else
     {
         m_item->setProperty("state", "offAir");
-        m_onAirTimer->stop();
+        stopOnAirTimer();
     }
-
-    emit stateChanged(m_name, isOnAir());
 }
 
 void Graphic::setGraphicsProperty(const QByteArray &name, const QVariant &value)
@@ -123,38 +702,147 @@ void Graphic::setGraphicsProperty(const QByteArray &name, const QVariant &value)
 
     if(!m_item)
     {
+        for(int i = 0; i < m_tempPropertyList.count(); ++i)
+        {
+            if(m_tempPropertyList[i].first == propertyName)
+            {
+                m_tempPropertyList.removeAt(i);
+                break;
+            }
+        }
+
         m_tempPropertyList.append(QPair<QString, QVariant>(propertyName, value));
+
+        if(m_component && m_component->isReady())
+        {
+            ++m_revision;
+            emit revisionChanged(this);
+        }
+
         return;
     }
 
-    m_item->setProperty(propertyName, value);
+    // Resolved once here, applying the change is then a direct meta-object write
+    int index = m_schema ? m_schema->propertyIndex(propertyName) : -1;
+
+    for(int i = 0; i < m_pendingPropertyList.count(); ++i)
+    {
+        PendingProperty &property = m_pendingPropertyList[i];
+
+        if(index != -1 ? property.index == index : property.name == propertyName)
+        {
+            property.value = value;
+            return;
+        }
+    }
+
+    PendingProperty property;
+    property.name = propertyName;
+    property.index = index;
+    property.value = value;
+    m_pendingPropertyList.append(property);
+
+    emit changesPending(this);
 }
 
-bool Graphic::isOnAir() const
+void Graphic::writeProperty(int index, const QByteArray &name, const QVariant &value)
 {
-    if(!m_item)
+    // Names the schema doesn't know fall back to the lookup by name
+    if(index != -1)
     {
-        return false;
+        m_item->metaObject()->property(index).write(m_item, value);
+    }
+    else
+    {
+        m_item->setProperty(name, value);
     }
-
-    return (m_item->property("state").toString() == "onAir");
 }
 
 QList<QPair<QString, QVariant> > Graphic::properties() const
 {
     QList<QPair<QString, QVariant> > propertyList;
 
-    foreach(const QString &name, m_propertyNames)
+    // Values set while there was no item, on top of the template defaults
+    if(!m_item)
+    {
+        if(!m_schema)
+        {
+            return m_tempPropertyList;
+        }
+
+        foreach(const TemplateSchema::Property &property, m_schema->properties())
+        {
+            QVariant value = property.defaultValue;
+
+            for(int i = 0; i < m_tempPropertyList.count(); ++i)
+            {
+                if(m_tempPropertyList[i].first == property.name)
+                {
+                    value = m_tempPropertyList[i].second;
+                }
+            }
+
+            propertyList.append(QPair<QString, QVariant>(property.name, value));
+        }
+
+        return propertyList;
+    }
+
+    if(!m_schema)
+    {
+        return propertyList;
+    }
+
+    const QMetaObject *metaObject = m_item->metaObject();
+
+    foreach(const TemplateSchema::Property &property, m_schema->properties())
     {
-        if(name.startsWith("qcg"))
+        propertyList.append(QPair<QString, QVariant>(property.name, metaObject->property(property.index).read(m_item)));
+    }
+
+    return propertyList;
+}
+
+QList<QPair<QString, QVariant> > Graphic::stagedProperties() const
+{
+    QList<QPair<QString, QVariant> > propertyList = properties();
+
+    foreach(const PendingProperty &pending, m_pendingPropertyList)
+    {
+        QString name = QString::fromLocal8Bit(pending.name);
+        bool found = false;
+
+        for(int i = 0; i < propertyList.count(); ++i)
+        {
+            if(propertyList[i].first == name)
+            {
+                propertyList[i].second = pending.value;
+                found = true;
+                break;
+            }
+        }
+
+        if(!found)
         {
-            propertyList.append(QPair<QString, QVariant>(name, m_item->property(name.toLocal8Bit())));
+            propertyList.append(QPair<QString, QVariant>(name, pending.value));
         }
     }
 
     return propertyList;
 }
 
+void Graphic::setGroup(const QString &name)
+{
+    if(name == m_group)
+    {
+        return;
+    }
+
+    QString previous = m_group;
+    m_group = name;
+    emit groupChanged(this, previous);
+}
+
 void Graphic::setOnAirTimerEnabled(bool enabled)
 {
     if(m_onAirTimerEnabled == enabled)
@@ -164,17 +852,45 @@ void Graphic::setOnAirTimerEnabled(bool enabled)
 
     m_onAirTimerEnabled = enabled;
 
-    if(!m_onAirTimerEnabled && m_onAirTimer->isActive())
+    if(!m_onAirTimerEnabled)
     {
-        m_onAirTimer->stop();
+        stopOnAirTimer();
     }
-    else if(m_onAirTimerEnabled && isOnAir())
+    else if(isOnAir())
     {
-        m_onAirTimer->start();
+        startOnAirTimer();
     }
 }
 
 void Graphic::setOnAirTimerInterval(int ms)
 {
-    m_onAirTimer->setInterval(ms);
+    m_onAirTimerInterval = ms;
+}
+
+void Graphic::startOnAirTimer()
+{
+    if(!m_timerWheel)
+    {
+        return;
+    }
+
+    // Restarted from now, like a single shot QTimer
+    stopOnAirTimer();
+    m_onAirTimerId = m_timerWheel->scheduleAfter(m_onAirTimerInterval, this, "onAirTimerExpired");
+}
+
+void Graphic::onAirTimerExpired()
+{
+    m_onAirTimerId = 0;
+    toggleOnAir();
+}
+
+void Graphic::stopOnAirTimer()
+{
+    if(m_timerWheel && m_onAirTimerId)
+    {
+        m_timerWheel->cancel(m_onAirTimerId);
+    }
+
+    m_onAirTimerId = 0;
 }
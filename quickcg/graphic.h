@@ -19,63 +19,180 @@
 #include <QObject>
 #include <QPair>
 #include <QStringList>
-#include <QTimer>
 #include <QPointer>
+#include <QSharedPointer>
 
-class QDeclarativeComponent;
-class QDeclarativeItem;
+class QQmlComponent;
+class TemplateSchema;
+class QQuickItem;
+class TimerWheel;
 
 class Graphic : public QObject
 {
     Q_OBJECT
 public:
+    // Follows the item's state and its transitions between offAir and onAir
+    enum State
+    {
+        OffAirState,
+        TransitioningInState,
+        OnAirState,
+        TransitioningOutState
+    };
+
+    static QString stateName(State state);
+
     explicit Graphic(const QString &name, QObject *parent = 0);
     virtual ~Graphic();
 
     QString name() const { return m_name; }
-    bool isValid() const { return m_component != 0; }
-
-    void setComponent(QDeclarativeComponent *component);
-    QDeclarativeComponent *component() const { return m_component; }
-
-    void setPropertyNames(const QStringList &list) { m_propertyNames = list; }
+    bool isValid() const { return !m_component.isNull(); }
+
+    // Components are shared by all graphics using the same template
+    void setComponent(const QSharedPointer<QQmlComponent> &component);
+    QQmlComponent *component() const { return m_component.data(); }
+    QQuickItem* item() const { return m_item; }
+
+    // The item is only created once the graphic is used, as soon as the component is ready
+    void materialize();
+    bool isMaterialized() const { return !m_item.isNull(); }
+    // Deletes the item of an idle off air graphic, its property values are kept for the next one
+    bool evict();
+    // Creates the item if needed and waits for its images to be decoded, prepared() follows,
+    // with ready false if the item could not be created
+    void cue();
+    bool isCueing() const { return m_cueing; }
+
+    // Rough size of the item tree and its cached layers in bytes
+    qint64 memoryEstimate() const { return m_memoryEstimate; }
+
+    // Swaps in a recompiled template on the next frame boundary, keeping property values and state
+    void reloadComponent(const QSharedPointer<QQmlComponent> &component, const QSharedPointer<const TemplateSchema> &schema);
+
+    void setTemplateName(const QString &name) { m_templateName = name; }
+    QString templateName() const { return m_templateName; }
+
+    void setSchema(const QSharedPointer<const TemplateSchema> &schema) { m_schema = schema; }
+    QSharedPointer<const TemplateSchema> schema() const { return m_schema; }
     void setGraphicsProperty(const QByteArray &name, const QVariant &value);
     QList<QPair<QString, QVariant> > properties() const;
+    // Including the values waiting for the next frame
+    QList<QPair<QString, QVariant> > stagedProperties() const;
+
+    State state() const { return m_state; }
+    // On air as soon as the transition in starts, like the item's state
+    bool isOnAir() const { return m_state == OnAirState || m_state == TransitioningInState; }
+    bool targetOnAir() const { return m_hasPendingOnAir ? m_pendingOnAir : isOnAir(); }
 
-    bool isOnAir() const;
+    bool hasPendingChanges() const { return m_hasPendingOnAir || !m_pendingPropertyList.isEmpty() || m_pendingComponent; }
+    bool hasPendingStateChange() const { return m_hasPendingOnAir; }
+    int pendingPropertyCount() const { return m_pendingPropertyList.count(); }
+    bool applyPendingChanges();
 
     void setOnAirTimerEnabled(bool enabled);
     bool onAirTimerEnabled() const { return m_onAirTimerEnabled; }
     void setOnAirTimerInterval(int ms);
-    int onAirTimerInterval() const { return m_onAirTimer->interval(); }
+    int onAirTimerInterval() const { return m_onAirTimerInterval; }
+    // Runs the on air timer, without one the graphic stays on air
+    void setTimerWheel(TimerWheel *wheel) { m_timerWheel = wheel; }
 
-    void setGroup(const QString& name) { m_group = name; }
+    void setGroup(const QString& name);
     QString group() const { return m_group; }
 
+    bool isCacheValid() const { return m_cacheValid; }
+
+    // Increases whenever the template is ready or replaced, or the properties change
+    quint64 revision() const { return m_revision; }
+
 public slots:
     void toggleOnAir();
     void setOnAir(bool state);
 
 protected slots:
+    void onComponentStatusChanged();
     void createItem();
+    void onImageStatusChanged();
+    void onAirTimerExpired();
+
+    void updateCache();
+
+    void onItemStateChanged(const QString &state);
+    void updateState();
+
+protected:
+    void applyOnAir(bool state);
+    void startOnAirTimer();
+    void stopOnAirTimer();
+    void writeProperty(int index, const QByteArray &name, const QVariant &value);
+    void prepareItem();
+    void failCue();
+    void failItem();
+    void waitForImages(QQuickItem *item);
+    void replaceItem();
+    QSharedPointer<const TemplateSchema> verifiedSchema(const QSharedPointer<const TemplateSchema> &schema, QObject *object);
+
+    void initCache();
+    void initState();
+    bool transitionsRunning() const;
+    void setCacheLayersEnabled(bool enabled);
+    void invalidateCache();
 
 private:
+    // Index is the meta-object property index from the schema, -1 if unknown
+    struct PendingProperty
+    {
+        QByteArray name;
+        int index;
+        QVariant value;
+    };
+
     QString m_name;
     QString m_group;
+    QString m_templateName;
 
-    QDeclarativeComponent *m_component;
-    QPointer<QDeclarativeItem> m_item;
+    QSharedPointer<QQmlComponent> m_component;
+    QPointer<QQuickItem> m_item;
+    bool m_materializeRequested;
+    // The template is missing or no item could be created from it
+    bool m_itemFailed;
+    bool m_cueing;
+    int m_loadingImages;
+    qint64 m_memoryEstimate;
 
     QList<QPair<QString, QVariant> > m_tempPropertyList;
-    QStringList m_propertyNames;
-
-    QTimer *m_onAirTimer;
+    QList<PendingProperty> m_pendingPropertyList;
+    State m_state;
+    bool m_itemOnAir;
+    bool m_hasPendingOnAir;
+    bool m_pendingOnAir;
+    QSharedPointer<const TemplateSchema> m_schema;
+    QSharedPointer<QQmlComponent> m_pendingComponent;
+    QSharedPointer<const TemplateSchema> m_pendingSchema;
+
+    TimerWheel *m_timerWheel;
+    int m_onAirTimerId;
+    int m_onAirTimerInterval;
     bool m_onAirTimerEnabled;
 
-signals:
-    void itemCreated(QDeclarativeItem *item);
+    QList<QPointer<QQuickItem> > m_cachedItems;
+    QList<QPointer<QObject> > m_transitions;
+    bool m_cacheValid;
+
+    quint64 m_revision;
 
-    void stateChanged(const QString &name, bool state);
+signals:
+    void itemCreated(QQuickItem *item);
+    void materialized(Graphic *graphic);
+    void prepared(Graphic *graphic, bool ready);
+    void groupChanged(Graphic *graphic, const QString &previous);
+    void changesPending(Graphic *graphic);
+    void cacheStateChanged(Graphic *graphic, bool valid);
+    void revisionChanged(Graphic *graphic);
+    // The schema didn't match the created item and was rebuilt from it
+    void schemaRebuilt(Graphic *graphic);
+
+    // state is a Graphic::State
+    void stateChanged(const QString &name, int state);
 };
 
 #endif // GRAPHIC_H
@@ -14,10 +14,64 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QApplication>
+#include <QGuiApplication>
+#include <QDebug>
 #include "mainwindow.h"
+#include "frameclock.h"
+#include "scaledoutput.h"
+#include "downscaler.h"
+#include "templateschema.h"
+#include "timerwheel.h"
 
 int main(int argc, char *argv[])
 {
+    // The benchmarks don't need a window or a scene
+    for(int i = 1; i < argc; ++i)
+    {
+        if(qstrcmp(argv[i], "--benchmark-downscale") == 0)
+        {
+            QList<QSize> sizes;
+            sizes << QSize(1280, 720) << QSize(960, 540) << QSize(480, 270);
+
+            return Downscaler::benchmark(QSize(1920, 1080), sizes, 200);
+        }
+        else if(qstrcmp(argv[i], "--benchmark-properties") == 0)
+        {
+            // The engine needs an application object but no window
+            if(qgetenv("QT_QPA_PLATFORM").isEmpty())
+            {
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            }
+
+            QGuiApplication a(argc, argv);
+
+            return TemplateSchema::benchmark(100000);
+        }
+        else if(qstrcmp(argv[i], "--check-timer-wheel") == 0)
+        {
+            return TimerWheel::check();
+        }
+    }
+
+    // Headless mode has to pick the offscreen platform plugin and the software
+    // GL rasterizer before the application object is created, so it can't
+    // wait for a.arguments().
+    for(int i = 1; i < argc; ++i)
+    {
+        if(qstrcmp(argv[i], "--headless") == 0)
+        {
+            if(qgetenv("QT_QPA_PLATFORM").isEmpty())
+            {
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            }
+
+            if(qgetenv("LIBGL_ALWAYS_SOFTWARE").isEmpty())
+            {
+                qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+            }
+        }
+    }
+
     QApplication a(argc, argv);
     a.setApplicationName("QuickCG");
     a.setApplicationVersion("0.1");
@@ -27,6 +81,12 @@ int main(int argc, char *argv[])
     QStringList arguments = a.arguments();
     arguments.removeFirst();
     bool fullscreen = false;
+    bool headless = false;
+    QString frameRingName;
+    QString frameRate;
+    QList<QSize> scaledSizes;
+    int channelCount = 1;
+    int itemMemoryBudget = -1;
 
     if(!arguments.isEmpty())
     {
@@ -36,12 +96,82 @@ int main(int argc, char *argv[])
             {
                 fullscreen = true;
             }
+            else if(argument == "--headless")
+            {
+                headless = true;
+            }
+            else if(argument.startsWith("--shm-output="))
+            {
+                frameRingName = argument.section('=', 1);
+            }
+            else if(argument.startsWith("--scaled-output="))
+            {
+                QSize size;
+
+                if(ScaledOutput::parseSize(argument.section('=', 1), &size))
+                {
+                    scaledSizes.append(size);
+                }
+                else
+                {
+                    qWarning() << "Invalid output size" << argument.section('=', 1);
+                }
+            }
+            else if(argument.startsWith("--frame-rate="))
+            {
+                frameRate = argument.section('=', 1);
+            }
+            else if(argument.startsWith("--channels="))
+            {
+                channelCount = qMax(1, argument.section('=', 1).toInt());
+            }
+            else if(argument.startsWith("--item-memory-budget="))
+            {
+                itemMemoryBudget = qMax(0, argument.section('=', 1).toInt());
+            }
+        }
+    }
+
+    // The scaled outputs are rings next to the full size one
+    if(!scaledSizes.isEmpty() && frameRingName.isEmpty())
+    {
+        qWarning() << "--scaled-output needs --shm-output";
+        return 1;
+    }
+
+    MainWindow w(channelCount);
+
+    // In megabytes
+    if(itemMemoryBudget >= 0)
+    {
+        w.setItemMemoryBudget(qint64(itemMemoryBudget) * 1024 * 1024);
+    }
+
+    if(!frameRate.isEmpty())
+    {
+        int numerator = 0;
+        int denominator = 0;
+
+        if(FrameClock::parseFrameRate(frameRate, &numerator, &denominator))
+        {
+            w.frameClock()->setFrameRate(numerator, denominator);
+        }
+        else
+        {
+            qWarning() << "Invalid frame rate" << frameRate;
         }
     }
 
-    MainWindow w;
+    if(!frameRingName.isEmpty() && !w.openFrameRings(frameRingName, scaledSizes))
+    {
+        qWarning() << "Failed to open shared memory output" << frameRingName;
+    }
 
-    if(fullscreen)
+    if(headless)
+    {
+        w.setHeadless(true);
+    }
+    else if(fullscreen)
     {
         w.showFullScreen();
     }
@@ -18,61 +18,143 @@
 #include "graphic.h"
 #include "show.h"
 #include "server.h"
+#include "channel.h"
+#include "renderer.h"
+#include "frameclock.h"
+#include "recorder.h"
+#include "thumbnailrenderer.h"
+#include "templatecache.h"
+#include "directoryindex.h"
+#include "timerwheel.h"
+#include "datafeed.h"
 
 #include <QShortcut>
-#include <QDeclarativeComponent>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQuickItem>
 #include <QUrl>
 #include <QDebug>
-#include <QDeclarativeItem>
 #include <QSettings>
 #include <QDomDocument>
 #include <QApplication>
-#include <QGraphicsRectItem>
-#include <QGraphicsSimpleTextItem>
 #include <QNetworkInterface>
+#include <QDateTime>
+#include <QTimer>
 
-MainWindow::MainWindow(QWidget *parent) :
+MainWindow::MainWindow(int channelCount, QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    m_show(0),
     m_server(0),
+    m_engine(0),
+    m_templateCache(0),
+    m_frameClock(0),
+    m_timerWheel(0),
+    m_recorder(0),
+    m_recordingChannel(0),
+    m_thumbnailRenderer(0),
+    m_headless(false),
+    m_itemMemoryBudget(256 * 1024 * 1024),
+    m_templateIndex(0),
+    m_showIndex(0),
     m_addressInfoItem(NULL)
 {
     initDirs();
 
+    m_templateIndex = new DirectoryIndex(m_templateDir, QStringList() << "*.qml", this);
+    m_showIndex = new DirectoryIndex(m_showDir, QStringList() << "*.show", this);
+
     ui->setupUi(this);
 
-    ui->m_graphicsView->scene()->setBackgroundBrush(Qt::green);
+    // Lets the engine reuse compiled templates between runs
+    if(qgetenv("QML_DISK_CACHE_PATH").isEmpty())
+    {
+        qputenv("QML_DISK_CACHE_PATH", QFile::encodeName(m_cacheDir.absoluteFilePath("qml")));
+    }
+
+    m_engine = new QQmlEngine(this);
+    m_templateCache = new TemplateCache(m_engine);
+    m_templateCache->setCacheFile(m_cacheDir.absoluteFilePath("templates.cache"));
+    connect(m_templateCache, SIGNAL(templateReloaded(QString)),
+            this, SLOT(reloadTemplate(QString)));
+
+    for(int i = 0; i < qMax(1, channelCount); ++i)
+    {
+        m_channels.append(new Channel(i, this));
+    }
+
+    // The window shows the program output of the first channel
+    connect(m_channels.first()->renderer(), SIGNAL(frameRendered(QImage)),
+            ui->m_frameView, SLOT(setFrame(QImage)));
 
     (void) new QShortcut(Qt::CTRL + Qt::Key_F, this, SLOT(toggleFullscreen()), 0, Qt::ApplicationShortcut);
     (void) new QShortcut(Qt::CTRL + Qt::Key_Q, this, SLOT(quit()), 0, Qt::ApplicationShortcut);
 
+    m_frameClock = new FrameClock(this);
+    connect(m_frameClock, SIGNAL(tick(quint64)),
+            this, SLOT(processFrame(quint64)));
+
+    m_timerWheel = new TimerWheel(m_frameClock, this);
+
+    loadFeeds();
+
     m_server = new Server(this);
+    connect(m_showIndex, SIGNAL(changed()),
+            this, SLOT(sendShowLists()));
+
+    foreach(Channel *channel, m_channels)
+    {
+        connect(channel->renderer(), SIGNAL(frameRepeated()),
+                m_frameClock, SLOT(countRepeatedFrame()));
+        connect(channel, SIGNAL(graphicStateChanged(int,QString,int)),
+                m_server, SLOT(sendGraphicStateChanged(int,QString,int)));
+        connect(channel, SIGNAL(graphicCued(int,QString,bool)),
+                m_server, SLOT(sendGraphicCued(int,QString,bool)));
+        connect(channel, SIGNAL(graphicsCleared(int,QString,QStringList)),
+                m_server, SLOT(sendGraphicsCleared(int,QString,QStringList)));
+        connect(channel, SIGNAL(rundownStatusChanged(int)),
+                m_server, SLOT(sendRundownStatus(int)));
+        connect(channel, SIGNAL(showChanged(int)),
+                m_server, SLOT(sendShowList(int)));
+        connect(channel, SIGNAL(loadProgress(int,QString,int,int)),
+                m_server, SLOT(sendShowLoadProgress(int,QString,int,int)));
+    }
+
+    m_recorder = new Recorder(this);
+    connect(m_recorder, SIGNAL(overflow(quint64)),
+            m_server, SLOT(sendRecordingOverflow(quint64)));
+    connect(m_recorder, SIGNAL(finished(QString,quint64,quint64)),
+            m_server, SLOT(sendRecordingFinished(QString,quint64,quint64)));
+
+    m_thumbnailRenderer = new ThumbnailRenderer(m_channels.first()->renderer()->outputSize(), this);
+    connect(m_thumbnailRenderer, SIGNAL(thumbnailChanged(int,QString,quint64,QByteArray)),
+            m_server, SLOT(sendGraphicThumbnail(int,QString,quint64,QByteArray)));
 
     QStringList showList = shows();
 
     if(!showList.isEmpty())
     {
-        QString current = QSettings().value("CurrentShow").toString();
-
-        if(current.isEmpty())
+        foreach(Channel *channel, m_channels)
         {
-            current = showList.first();
-        }
+            QString current = channel->savedShow();
 
-        setCurrentShow(current);
+            if(current.isEmpty())
+            {
+                current = showList.first();
+            }
+
+            channel->setCurrentShow(current);
+        }
     }
 
-    m_addressInfoItem = new QGraphicsRectItem;
-    m_addressInfoItem->setBrush(Qt::white);
-    m_addressInfoItem->setRect(0, 0, 1920, 1080);
-    ui->m_graphicsView->scene()->addItem(m_addressInfoItem);
-    QGraphicsSimpleTextItem *textitem = new QGraphicsSimpleTextItem(m_addressInfoItem);
-    textitem->setBrush(Qt::black);
-    textitem->setPos(20, 20);
-    QFont f = font();
-    f.setPointSize(30);
-    textitem->setFont(f);
+    QQmlComponent addressComponent(m_engine);
+    addressComponent.setData("import QtQuick 2.0\n"
+                             "Rectangle {\n"
+                             "    width: 1920; height: 1080; color: \"white\"\n"
+                             "    property alias text: label.text\n"
+                             "    Text { id: label; x: 20; y: 20; color: \"black\"; font.pointSize: 30 }\n"
+                             "}\n", QUrl());
+    m_addressInfoItem = qobject_cast<QQuickItem*>(addressComponent.create());
+
     QNetworkInterface net;
     QString text;
 
@@ -86,17 +168,34 @@ MainWindow::MainWindow(QWidget *parent) :
         text += address.toString();
     }
 
-    textitem->setText("Addresses:\n" + text);
+    if(m_addressInfoItem)
+    {
+        m_addressInfoItem->setProperty("text", QString("Addresses:\n" + text));
+        m_channels.first()->addItem(m_addressInfoItem);
+    }
+
+    // Started from the event loop, so a frame rate set after construction
+    // doesn't restart the clock
+    QTimer::singleShot(0, m_frameClock, SLOT(start()));
 }
 
 MainWindow::~MainWindow()
 {
-    if(m_show)
+    delete m_addressInfoItem;
+
+    // The channels' items have to go before the engine that created them
+    foreach(Channel *channel, m_channels)
     {
-        m_show->save();
-        QSettings().setValue("CurrentShow", m_show->showName());
+        channel->saveShow();
     }
 
+    delete m_thumbnailRenderer;
+    m_thumbnailRenderer = 0;
+
+    qDeleteAll(m_channels);
+    m_channels.clear();
+
+    delete m_templateCache;
     delete ui;
 }
 
@@ -112,31 +211,6 @@ void MainWindow::toggleFullscreen()
     }
 }
 
-QDeclarativeComponent *MainWindow::loadTemplate(const QString &name)
-{
-    QUrl url = QUrl::fromLocalFile(m_templateDir.absoluteFilePath(name));
-    QDeclarativeComponent *component = new QDeclarativeComponent(ui->m_graphicsView->engine(), url);
-
-    if(component->isError())
-    {
-        qDebug() << "Failed to load component.";
-        component->deleteLater();
-        return 0;
-    }
-
-    return component;
-}
-
-void MainWindow::addItem(QDeclarativeItem* item)
-{
-    if(!item)
-    {
-        return;
-    }
-
-    ui->m_graphicsView->scene()->addItem(item);
-}
-
 void MainWindow::initDirs()
 {
     m_templateDir = QDir::home();
@@ -163,52 +237,44 @@ void MainWindow::initDirs()
     }
 
     m_showDir.cd("shows");
-}
-
-QStringList MainWindow::templates() const
-{
-    return m_templateDir.entryList(QStringList() << "*.qml", QDir::Files);
-}
 
-QStringList MainWindow::shows() const
-{
-    return m_showDir.entryList(QStringList() << "*.show", QDir::Files);
-}
+    m_recordingDir = m_showDir;
+    m_recordingDir.cdUp();
 
-void MainWindow::setCurrentShow(const QString& show)
-{
-    if(m_show)
+    if(!m_recordingDir.exists("recordings"))
     {
-        if(m_server)
-        {
-            disconnect(m_show, SIGNAL(graphicStateChanged(QString,bool)),
-                       m_server, SLOT(sendGraphicStateChanged(QString,bool)));
-        }
-
-        m_show->save();
-        m_show->deleteLater();
+        m_recordingDir.mkdir("recordings");
     }
 
-    QString absolutePath = m_showDir.absoluteFilePath(show);
-    QFileInfo info;
-    info.setFile(absolutePath);
+    m_recordingDir.cd("recordings");
+
+    m_cacheDir = m_recordingDir;
+    m_cacheDir.cdUp();
 
-    if(info.exists() && info.isFile())
+    if(!m_cacheDir.exists("cache"))
     {
-        m_show = new Show(this);
-        m_show->load(absolutePath);
+        m_cacheDir.mkdir("cache");
+    }
 
-        if(m_server)
-        {
-            connect(m_show, SIGNAL(graphicStateChanged(QString,bool)),
-                    m_server, SLOT(sendGraphicStateChanged(QString,bool)));
+    m_cacheDir.cd("cache");
 
-            m_server->sendShowList();
-        }
+    if(!m_cacheDir.exists("qml"))
+    {
+        m_cacheDir.mkdir("qml");
     }
 }
 
-void MainWindow::createShow(const QString &name)
+QStringList MainWindow::templates() const
+{
+    return m_templateIndex->fileNames();
+}
+
+QStringList MainWindow::shows() const
+{
+    return m_showIndex->fileNames();
+}
+
+void MainWindow::createShow(const QString &name, Channel *channel)
 {
     if(name.isEmpty())
     {
@@ -237,8 +303,12 @@ void MainWindow::createShow(const QString &name)
     QDomElement rootElement = doc.createElement("QuickCGShow");
     doc.appendChild(rootElement);
     file.write(doc.toString(4).toLocal8Bit());
+    file.close();
 
-    setCurrentShow(filename);
+    // The show list sent for the new current show has to include it
+    m_showIndex->update(filename);
+
+    channel->setCurrentShow(filename);
 }
 
 void MainWindow::removeShow(const QString &name)
@@ -248,31 +318,245 @@ void MainWindow::removeShow(const QString &name)
         return;
     }
 
-    if(m_show && m_show->showName() == name)
+    foreach(Channel *channel, m_channels)
     {
-        m_show->deleteLater();
-        m_show = 0;
+        if(channel->currentShow() && channel->currentShow()->showName() == name)
+        {
+            channel->closeShow();
+        }
     }
 
     showDir().remove(name);
+    // Sends the new show list to the clients
+    m_showIndex->update(name);
+
+    QStringList showList = shows();
+
+    foreach(Channel *channel, m_channels)
+    {
+        if(!channel->currentShow() && !showList.isEmpty())
+        {
+            channel->setCurrentShow(showList.first());
+        }
+    }
+}
 
-    if(m_show)
+void MainWindow::setHeadless(bool headless)
+{
+    if(headless == m_headless)
+    {
+        return;
+    }
+
+    m_headless = headless;
+
+    // No need to hand frames to a window nobody sees
+    if(m_headless)
     {
-        m_server->sendShowList();
+        disconnect(m_channels.first()->renderer(), SIGNAL(frameRendered(QImage)),
+                   ui->m_frameView, SLOT(setFrame(QImage)));
+        hide();
     }
     else
     {
-        QStringList showList = shows();
+        connect(m_channels.first()->renderer(), SIGNAL(frameRendered(QImage)),
+                ui->m_frameView, SLOT(setFrame(QImage)));
+        show();
+    }
+}
 
-        if(!showList.isEmpty())
+bool MainWindow::openFrameRings(const QString &name, const QList<QSize> &scaledSizes)
+{
+    bool ok = true;
+
+    // The first channel uses the name as is, the others get their id appended
+    foreach(Channel *channel, m_channels)
+    {
+        QString ringName = name;
+
+        if(channel->id() > 0)
         {
-            setCurrentShow(showList.first());
+            ringName += QString("-%1").arg(channel->id());
         }
-        else
+
+        ok &= channel->openFrameRing(ringName);
+
+        // Scaled outputs get their size appended, e.g. quickcg-1280x720
+        foreach(const QSize &size, scaledSizes)
         {
-            m_server->sendShowList();
+            ok &= channel->addScaledOutput(QString("%1-%2x%3").arg(ringName).arg(size.width()).arg(size.height()), size);
         }
     }
+
+    return ok;
+}
+
+bool MainWindow::startRecording(Channel *channel, const QString &format, const QString &name)
+{
+    if(m_recorder->isRecording() || m_recorder->isFinishing())
+    {
+        qDebug() << "A recording is already in progress";
+        return false;
+    }
+
+    Recorder::Format recorderFormat;
+
+    if(!Recorder::formatFromString(format, &recorderFormat))
+    {
+        qDebug() << "Unknown recording format" << format;
+        return false;
+    }
+
+    QString fileName = name;
+
+    if(fileName.isEmpty())
+    {
+        fileName = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+
+        if(recorderFormat == Recorder::RawFormat)
+        {
+            fileName += ".raw";
+        }
+        else if(recorderFormat == Recorder::AviFormat)
+        {
+            fileName += ".avi";
+        }
+    }
+
+    // Frames are handed over on the render thread, so the recorder only switches channels while idle
+    if(channel != m_recordingChannel)
+    {
+        if(m_recordingChannel)
+        {
+            disconnect(m_recordingChannel->renderer(), SIGNAL(frameRendered(QImage)),
+                       m_recorder, SLOT(addFrame(QImage)));
+        }
+
+        m_recordingChannel = channel;
+        connect(m_recordingChannel->renderer(), SIGNAL(frameRendered(QImage)),
+                m_recorder, SLOT(addFrame(QImage)), Qt::DirectConnection);
+    }
+
+    return m_recorder->start(m_recordingDir.absoluteFilePath(fileName), recorderFormat, channel->renderer()->outputSize(),
+                             m_frameClock->frameRateNumerator(), m_frameClock->frameRateDenominator());
+}
+
+void MainWindow::stopRecording()
+{
+    m_recorder->stop();
+}
+
+bool MainWindow::addFeed(DataFeed *feed)
+{
+    // Closed first, the new feed may use the same pipe or socket
+    if(m_feeds.contains(feed->name()))
+    {
+        delete m_feeds.take(feed->name());
+        saveFeeds();
+    }
+
+    if(!feed->open())
+    {
+        delete feed;
+        return false;
+    }
+
+    feed->setParent(this);
+    m_feeds.insert(feed->name(), feed);
+    saveFeeds();
+
+    return true;
+}
+
+void MainWindow::removeFeed(const QString &name)
+{
+    DataFeed *feed = m_feeds.take(name);
+
+    if(!feed)
+    {
+        return;
+    }
+
+    delete feed;
+    saveFeeds();
+}
+
+void MainWindow::loadFeeds()
+{
+    QSettings settings;
+    int count = settings.beginReadArray("Feeds");
+
+    for(int i = 0; i < count; ++i)
+    {
+        settings.setArrayIndex(i);
+
+        DataFeed::Type type;
+        QString name = settings.value("Name").toString();
+
+        if(name.isEmpty() || !DataFeed::typeFromName(settings.value("Type").toString(), &type))
+        {
+            continue;
+        }
+
+        // Kept even if it fails to open, so it stays configured
+        DataFeed *feed = new DataFeed(name, type, settings.value("Path").toString(), this);
+        feed->open();
+        m_feeds.insert(name, feed);
+    }
+
+    settings.endArray();
+}
+
+void MainWindow::saveFeeds()
+{
+    QSettings settings;
+    settings.remove("Feeds");
+    settings.beginWriteArray("Feeds", m_feeds.count());
+
+    int i = 0;
+
+    foreach(DataFeed *feed, m_feeds)
+    {
+        settings.setArrayIndex(i++);
+        settings.setValue("Name", feed->name());
+        settings.setValue("Type", DataFeed::typeName(feed->type()));
+        settings.setValue("Path", feed->path());
+    }
+
+    settings.endArray();
+}
+
+void MainWindow::processFrame(quint64 frame)
+{
+    // Timed actions queue their changes for this frame
+    m_timerWheel->advance(frame);
+
+    foreach(Channel *channel, m_channels)
+    {
+        channel->processFrame();
+    }
+
+    // Previews go after the program output has been started for this tick
+    m_thumbnailRenderer->processFrame();
+}
+
+void MainWindow::reloadTemplate(const QString &path)
+{
+    foreach(Channel *channel, m_channels)
+    {
+        if(channel->currentShow())
+        {
+            channel->currentShow()->reloadTemplate(path);
+        }
+    }
+}
+
+void MainWindow::sendShowLists()
+{
+    foreach(Channel *channel, m_channels)
+    {
+        m_server->sendShowList(channel->id());
+    }
 }
 
 void MainWindow::quit()
@@ -284,4 +568,5 @@ void MainWindow::removeAddressInfo()
 {
     delete m_addressInfoItem;
     m_addressInfoItem = NULL;
+    m_channels.first()->renderer()->invalidate();
 }
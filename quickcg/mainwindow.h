@@ -18,64 +18,123 @@
 
 #include <QMainWindow>
 #include <QDir>
+#include <QSize>
+#include <QSharedPointer>
+#include <QMap>
 
 namespace Ui {
     class MainWindow;
 }
 
 class QUrl;
-class QDeclarativeItem;
-class QDeclarativeComponent;
-class QGraphicsRectItem;
-class Show;
+class QQmlEngine;
+class QQmlComponent;
+class QQuickItem;
 class Server;
+class Channel;
+class FrameClock;
+class Recorder;
+class TemplateCache;
+class DirectoryIndex;
+class ThumbnailRenderer;
+class TimerWheel;
+class DataFeed;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget *parent = 0);
+    explicit MainWindow(int channelCount = 1, QWidget *parent = 0);
     ~MainWindow();
 
-    QDeclarativeComponent* loadTemplate(const QString &name);
+    TemplateCache* templateCache() const { return m_templateCache; }
+    QQmlEngine* engine() const { return m_engine; }
 
-    Show* currentShow() const { return m_show; }
+    int channelCount() const { return m_channels.count(); }
+    Channel* channel(int id) const { return m_channels.value(id); }
+    QList<Channel*> channels() const { return m_channels; }
 
     QStringList templates() const;
     QDir templateDir() const { return m_templateDir; }
+    DirectoryIndex* templateIndex() const { return m_templateIndex; }
 
     QStringList shows() const;
     QDir showDir() const { return m_showDir; }
+    DirectoryIndex* showIndex() const { return m_showIndex; }
 
-    void createShow(const QString &name);
+    void createShow(const QString &name, Channel *channel);
     void removeShow(const QString &name);
 
     void removeAddressInfo();
 
-public slots:
-    void addItem(QDeclarativeItem* item);
+    void setHeadless(bool headless);
+    bool isHeadless() const { return m_headless; }
 
-    void setCurrentShow(const QString& show);
+    bool openFrameRings(const QString &name, const QList<QSize> &scaledSizes = QList<QSize>());
+
+    FrameClock* frameClock() const { return m_frameClock; }
+    TimerWheel* timerWheel() const { return m_timerWheel; }
+
+    ThumbnailRenderer* thumbnailRenderer() const { return m_thumbnailRenderer; }
+
+    // Idle off air items of each show are deleted beyond this, 0 keeps them all
+    void setItemMemoryBudget(qint64 bytes) { m_itemMemoryBudget = bytes; }
+    qint64 itemMemoryBudget() const { return m_itemMemoryBudget; }
+
+    Recorder* recorder() const { return m_recorder; }
+    QDir recordingDir() const { return m_recordingDir; }
+    // Records the output of channel, the recorder is moved to it when idle
+    bool startRecording(Channel *channel, const QString &format, const QString &name);
+    void stopRecording();
+
+    // Takes ownership and replaces a feed with the same name, deleted if it can't be opened
+    bool addFeed(DataFeed *feed);
+    void removeFeed(const QString &name);
+    DataFeed* feed(const QString &name) const { return m_feeds.value(name); }
+    QList<DataFeed*> feeds() const { return m_feeds.values(); }
 
 protected slots:
     void toggleFullscreen();
 
+    void processFrame(quint64 frame);
+    void reloadTemplate(const QString &path);
+    void sendShowLists();
+
     void quit();
 
 protected:
     void initDirs();
+    void loadFeeds();
+    void saveFeeds();
 
 private:
     Ui::MainWindow *ui;
 
-    Show *m_show;
     Server *m_server;
+    QQmlEngine *m_engine;
+    TemplateCache *m_templateCache;
+    QList<Channel*> m_channels;
+    FrameClock *m_frameClock;
+    TimerWheel *m_timerWheel;
+    Recorder *m_recorder;
+    Channel *m_recordingChannel;
+    ThumbnailRenderer *m_thumbnailRenderer;
+
+    bool m_headless;
+    qint64 m_itemMemoryBudget;
 
     QDir m_templateDir;
     QDir m_showDir;
+    QDir m_recordingDir;
+    QDir m_cacheDir;
+
+    DirectoryIndex *m_templateIndex;
+    DirectoryIndex *m_showIndex;
+
+    QMap<QString, DataFeed*> m_feeds;
 
-    QGraphicsRectItem *m_addressInfoItem;
+    QQuickItem *m_addressInfoItem;
 };
 
 #endif // MAINWINDOW_H
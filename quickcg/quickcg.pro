@@ -1,19 +1,53 @@
-QT += core gui declarative xml network widgets
+QT += core gui qml quick xml network widgets concurrent
 
 TARGET = quickcg
 TEMPLATE = app
 
+unix:!macx: LIBS += -lrt
+
 SOURCES += main.cpp\
     mainwindow.cpp \
     graphic.cpp \
     show.cpp \
     server.cpp \
-    clientconnection.cpp
+    clientconnection.cpp \
+    renderer.cpp \
+    framering.cpp \
+    frameclock.cpp \
+    frameview.cpp \
+    recorder.cpp \
+    channel.cpp \
+    renderstats.cpp \
+    downscaler.cpp \
+    scaledoutput.cpp \
+    thumbnailrenderer.cpp \
+    templatecache.cpp \
+    templateschema.cpp \
+    directoryindex.cpp \
+    timerwheel.cpp \
+    rundown.cpp \
+    datafeed.cpp
 
 HEADERS += mainwindow.h \
     graphic.h \
     show.h \
     server.h \
-    clientconnection.h
+    clientconnection.h \
+    renderer.h \
+    framering.h \
+    frameclock.h \
+    frameview.h \
+    recorder.h \
+    channel.h \
+    renderstats.h \
+    downscaler.h \
+    scaledoutput.h \
+    thumbnailrenderer.h \
+    templatecache.h \
+    templateschema.h \
+    directoryindex.h \
+    timerwheel.h \
+    rundown.h \
+    datafeed.h
 
 FORMS += mainwindow.ui
@@ -0,0 +1,432 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "recorder.h"
+
+#include <QThread>
+#include <QDataStream>
+#include <QDebug>
+
+static const quint32 AviFrameFlags = 0x10; // AVIIF_KEYFRAME
+static const quint32 AviHasIndex = 0x10; // AVIF_HASINDEX
+static const qint64 AviMaxSize = Q_INT64_C(0xF0000000); // Leave room for the index in the 4GB RIFF limit
+
+class RecorderWorker : public QThread
+{
+public:
+    explicit RecorderWorker(Recorder *recorder) :
+        m_recorder(recorder)
+    {
+    }
+
+protected:
+    virtual void run();
+
+private:
+    Recorder *m_recorder;
+};
+
+void RecorderWorker::run()
+{
+    QImage frame;
+    quint64 index = 0;
+
+    while(m_recorder->takeFrame(&frame, &index))
+    {
+        m_recorder->writeFrame(frame, index);
+        frame = QImage();
+    }
+
+    m_recorder->workerFinished();
+}
+
+static void writeFourCC(QDataStream &stream, const char *fourcc)
+{
+    stream.writeRawData(fourcc, 4);
+}
+
+Recorder::Recorder(QObject *parent) :
+    QObject(parent), m_format(RawFormat), m_rateNumerator(25), m_rateDenominator(1),
+    m_maxQueueLength(25), m_stopping(false), m_overflowing(false), m_nextIndex(0),
+    m_recording(0), m_activeWorkers(0), m_moviStart(0), m_framesWritten(0), m_framesDropped(0)
+{
+}
+
+Recorder::~Recorder()
+{
+    stop();
+
+    foreach(QThread *worker, m_workers)
+    {
+        worker->wait();
+        delete worker;
+    }
+}
+
+bool Recorder::formatFromString(const QString &text, Format *format)
+{
+    QString name = text.toLower();
+
+    if(name == "raw")
+    {
+        *format = RawFormat;
+    }
+    else if(name == "png")
+    {
+        *format = PngSequenceFormat;
+    }
+    else if(name == "avi")
+    {
+        *format = AviFormat;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool Recorder::start(const QString &path, Format format, const QSize &size, int rateNumerator, int rateDenominator)
+{
+    if(isRecording() || isFinishing())
+    {
+        qDebug() << "A recording is already in progress";
+        return false;
+    }
+
+    foreach(QThread *worker, m_workers)
+    {
+        worker->wait();
+        delete worker;
+    }
+
+    m_workers.clear();
+
+    m_format = format;
+    m_path = path;
+    m_size = size;
+    m_rateNumerator = rateNumerator;
+    m_rateDenominator = rateDenominator;
+    m_stopping = false;
+    m_overflowing = false;
+    m_nextIndex = 0;
+    m_framesWritten.storeRelease(0);
+    m_framesDropped.storeRelease(0);
+    m_frameOffsets.clear();
+
+    int workerCount = 1;
+
+    if(m_format == PngSequenceFormat)
+    {
+        // Encoding dominates, so spread the frames over several workers
+        if(!QDir().mkpath(m_path))
+        {
+            qDebug() << "Failed to create recording directory" << m_path;
+            return false;
+        }
+
+        m_sequenceDir = QDir(m_path);
+        workerCount = qBound(1, QThread::idealThreadCount() - 1, 4);
+    }
+    else
+    {
+        m_file.setFileName(m_path);
+
+        if(!m_file.open(QIODevice::WriteOnly))
+        {
+            qDebug() << "Failed to open" << m_path << "for writing with the following error:" << m_file.errorString();
+            return false;
+        }
+
+        if(m_format == AviFormat && !writeAviHeader())
+        {
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_activeWorkers.storeRelease(workerCount);
+
+    for(int i = 0; i < workerCount; ++i)
+    {
+        QThread *worker = new RecorderWorker(this);
+        worker->setObjectName("QuickCG recorder");
+        m_workers.append(worker);
+        worker->start(QThread::LowPriority);
+    }
+
+    m_recording.storeRelease(1);
+
+    return true;
+}
+
+void Recorder::stop()
+{
+    if(!isRecording())
+    {
+        return;
+    }
+
+    m_recording.storeRelease(0);
+
+    // The workers drain what is left in the queue and the last one closes the file
+    QMutexLocker lock(&m_queueMutex);
+    m_stopping = true;
+    m_queueCondition.wakeAll();
+}
+
+void Recorder::addFrame(const QImage &frame)
+{
+    if(!isRecording() || frame.size() != m_size)
+    {
+        return;
+    }
+
+    QMutexLocker lock(&m_queueMutex);
+
+    if(m_stopping)
+    {
+        return;
+    }
+
+    if(m_queue.count() >= m_maxQueueLength)
+    {
+        m_framesDropped.fetchAndAddOrdered(1);
+
+        // Only report the start of an overflow, not every dropped frame
+        if(!m_overflowing)
+        {
+            m_overflowing = true;
+            emit overflow(m_framesDropped.loadAcquire());
+        }
+
+        return;
+    }
+
+    m_overflowing = false;
+    m_queue.enqueue(qMakePair(m_nextIndex++, frame));
+    m_queueCondition.wakeOne();
+}
+
+bool Recorder::takeFrame(QImage *frame, quint64 *index)
+{
+    QMutexLocker lock(&m_queueMutex);
+
+    while(m_queue.isEmpty())
+    {
+        if(m_stopping)
+        {
+            return false;
+        }
+
+        m_queueCondition.wait(&m_queueMutex);
+    }
+
+    QPair<quint64, QImage> entry = m_queue.dequeue();
+    *index = entry.first;
+    *frame = entry.second;
+
+    return true;
+}
+
+void Recorder::writeFrame(const QImage &frame, quint64 index)
+{
+    switch(m_format)
+    {
+    case RawFormat:
+        if(m_file.write(reinterpret_cast<const char*>(frame.constBits()), frame.sizeInBytes()) != frame.sizeInBytes())
+        {
+            qDebug() << "Failed writing frame to" << m_path << ":" << m_file.errorString();
+            return;
+        }
+        break;
+    case PngSequenceFormat:
+        if(!frame.save(m_sequenceDir.absoluteFilePath(QString("frame%1.png").arg(index, 8, 10, QChar('0'))), "PNG"))
+        {
+            qDebug() << "Failed writing frame" << index << "to" << m_path;
+            return;
+        }
+        break;
+    case AviFormat:
+        if(!writeAviFrame(frame))
+        {
+            return;
+        }
+        break;
+    }
+
+    m_framesWritten.fetchAndAddOrdered(1);
+}
+
+void Recorder::workerFinished()
+{
+    if(m_activeWorkers.fetchAndAddOrdered(-1) != 1)
+    {
+        return;
+    }
+
+    if(m_format == AviFormat)
+    {
+        finishAvi();
+    }
+
+    if(m_file.isOpen())
+    {
+        m_file.close();
+    }
+
+    emit finished(m_path, framesWritten(), framesDropped());
+}
+
+bool Recorder::writeAviHeader()
+{
+    // Uncompressed RIFF AVI with one 32 bit DIB video stream. The sizes and
+    // frame counts are patched in by finishAvi() once the recording stops.
+    const quint32 frameSize = m_size.width() * m_size.height() * 4;
+    const quint32 microSecondsPerFrame = quint32(qint64(1000000) * m_rateDenominator / m_rateNumerator);
+
+    QDataStream stream(&m_file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    writeFourCC(stream, "RIFF");
+    stream << quint32(0);
+    writeFourCC(stream, "AVI ");
+
+    writeFourCC(stream, "LIST");
+    stream << quint32(4 + 8 + 56 + 8 + 4 + 8 + 56 + 8 + 40);
+    writeFourCC(stream, "hdrl");
+
+    writeFourCC(stream, "avih");
+    stream << quint32(56);
+    stream << microSecondsPerFrame;
+    stream << quint32(qint64(frameSize) * m_rateNumerator / m_rateDenominator);
+    stream << quint32(0); // Padding granularity
+    stream << AviHasIndex;
+    stream << quint32(0); // Total frames
+    stream << quint32(0); // Initial frames
+    stream << quint32(1); // Streams
+    stream << frameSize;
+    stream << quint32(m_size.width());
+    stream << quint32(m_size.height());
+    stream << quint32(0) << quint32(0) << quint32(0) << quint32(0);
+
+    writeFourCC(stream, "LIST");
+    stream << quint32(4 + 8 + 56 + 8 + 40);
+    writeFourCC(stream, "strl");
+
+    writeFourCC(stream, "strh");
+    stream << quint32(56);
+    writeFourCC(stream, "vids");
+    writeFourCC(stream, "DIB ");
+    stream << quint32(0); // Flags
+    stream << quint16(0) << quint16(0); // Priority and language
+    stream << quint32(0); // Initial frames
+    stream << quint32(m_rateDenominator);
+    stream << quint32(m_rateNumerator);
+    stream << quint32(0); // Start
+    stream << quint32(0); // Length
+    stream << frameSize;
+    stream << quint32(0xFFFFFFFF); // Quality
+    stream << quint32(0); // Sample size
+    stream << qint16(0) << qint16(0) << qint16(m_size.width()) << qint16(m_size.height());
+
+    writeFourCC(stream, "strf");
+    stream << quint32(40);
+    stream << quint32(40);
+    stream << qint32(m_size.width());
+    stream << qint32(m_size.height());
+    stream << quint16(1) << quint16(32);
+    stream << quint32(0); // BI_RGB
+    stream << frameSize;
+    stream << qint32(0) << qint32(0) << quint32(0) << quint32(0);
+
+    writeFourCC(stream, "LIST");
+    stream << quint32(0);
+    m_moviStart = m_file.pos();
+    writeFourCC(stream, "movi");
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        qDebug() << "Failed writing AVI header to" << m_path << ":" << m_file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool Recorder::writeAviFrame(const QImage &frame)
+{
+    const int bytesPerLine = frame.width() * 4;
+    const quint32 frameSize = bytesPerLine * frame.height();
+
+    if(m_file.pos() + frameSize + 8 > AviMaxSize)
+    {
+        qDebug() << "AVI recording" << m_path << "reached its maximum size, frame dropped";
+        m_framesDropped.fetchAndAddOrdered(1);
+        return false;
+    }
+
+    QDataStream stream(&m_file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    m_frameOffsets.append(quint32(m_file.pos() - m_moviStart));
+    writeFourCC(stream, "00db");
+    stream << frameSize;
+
+    // DIBs are stored bottom up
+    for(int y = frame.height() - 1; y >= 0; --y)
+    {
+        stream.writeRawData(reinterpret_cast<const char*>(frame.constScanLine(y)), bytesPerLine);
+    }
+
+    return true;
+}
+
+void Recorder::finishAvi()
+{
+    const quint32 frameSize = m_size.width() * m_size.height() * 4;
+    const quint32 frameCount = m_frameOffsets.count();
+
+    QDataStream stream(&m_file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    const qint64 moviEnd = m_file.pos();
+
+    writeFourCC(stream, "idx1");
+    stream << quint32(frameCount * 16);
+
+    foreach(quint32 offset, m_frameOffsets)
+    {
+        writeFourCC(stream, "00db");
+        stream << AviFrameFlags << offset << frameSize;
+    }
+
+    const qint64 fileEnd = m_file.pos();
+
+    m_file.seek(4);
+    stream << quint32(fileEnd - 8);
+
+    m_file.seek(m_moviStart - 4);
+    stream << quint32(moviEnd - m_moviStart);
+
+    // dwTotalFrames in avih and dwLength in strh
+    m_file.seek(12 + 12 + 8 + 16);
+    stream << frameCount;
+    m_file.seek(12 + 12 + 8 + 56 + 12 + 8 + 32);
+    stream << frameCount;
+
+    m_file.seek(fileEnd);
+}
@@ -0,0 +1,110 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <QObject>
+#include <QImage>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QDir>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+class QThread;
+
+// Records program output. Frames are handed over from the render thread
+// into a bounded queue that is drained by worker threads, when the queue
+// is full frames are dropped instead of waiting.
+class Recorder : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format
+    {
+        RawFormat,
+        PngSequenceFormat,
+        AviFormat
+    };
+
+    explicit Recorder(QObject *parent = 0);
+    ~Recorder();
+
+    static bool formatFromString(const QString &text, Format *format);
+
+    void setMaxQueueLength(int frames) { m_maxQueueLength = frames; }
+    int maxQueueLength() const { return m_maxQueueLength; }
+
+    bool start(const QString &path, Format format, const QSize &size, int rateNumerator, int rateDenominator);
+    void stop();
+
+    bool isRecording() const { return m_recording.loadAcquire() != 0; }
+    bool isFinishing() const { return m_activeWorkers.loadAcquire() != 0; }
+    QString path() const { return m_path; }
+
+    quint64 framesWritten() const { return m_framesWritten.loadAcquire(); }
+    quint64 framesDropped() const { return m_framesDropped.loadAcquire(); }
+
+public slots:
+    // Called from the render thread, never blocks on disk I/O
+    void addFrame(const QImage &frame);
+
+protected:
+    bool takeFrame(QImage *frame, quint64 *index);
+    void writeFrame(const QImage &frame, quint64 index);
+    void workerFinished();
+
+    bool writeAviHeader();
+    bool writeAviFrame(const QImage &frame);
+    void finishAvi();
+
+private:
+    Format m_format;
+    QString m_path;
+    QSize m_size;
+    int m_rateNumerator;
+    int m_rateDenominator;
+
+    QMutex m_queueMutex;
+    QWaitCondition m_queueCondition;
+    QQueue<QPair<quint64, QImage> > m_queue;
+    int m_maxQueueLength;
+    bool m_stopping;
+    bool m_overflowing;
+    quint64 m_nextIndex;
+
+    QAtomicInt m_recording;
+    QAtomicInt m_activeWorkers;
+    QList<QThread*> m_workers;
+
+    QFile m_file;
+    QDir m_sequenceDir;
+    qint64 m_moviStart;
+    QList<quint32> m_frameOffsets;
+
+    QAtomicInteger<quint64> m_framesWritten;
+    QAtomicInteger<quint64> m_framesDropped;
+
+signals:
+    void overflow(quint64 framesDropped);
+    void finished(const QString &path, quint64 framesWritten, quint64 framesDropped);
+
+    friend class RecorderWorker;
+};
+
+#endif // RECORDER_H
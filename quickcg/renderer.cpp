@@ -0,0 +1,317 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "renderer.h"
+
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+#include <QQuickItem>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+#include <QCoreApplication>
+#include <QThread>
+#include <QEvent>
+#include <QElapsedTimer>
+#include <QDebug>
+
+static const QEvent::Type InitEvent = QEvent::Type(QEvent::User + 1);
+static const QEvent::Type RenderEvent = QEvent::Type(QEvent::User + 2);
+static const QEvent::Type StopEvent = QEvent::Type(QEvent::User + 3);
+static const QEvent::Type RepeatEvent = QEvent::Type(QEvent::User + 4);
+
+// Lives on the render thread and owns everything that needs the GL context
+class RenderWorker : public QObject
+{
+public:
+    explicit RenderWorker(Renderer *renderer) :
+        m_renderer(renderer), m_fbo(0)
+    {
+    }
+
+    virtual bool event(QEvent *event);
+
+protected:
+    void init();
+    void render();
+    void repeat();
+    void cleanup();
+
+private:
+    Renderer *m_renderer;
+    QOpenGLFramebufferObject *m_fbo;
+};
+
+bool RenderWorker::event(QEvent *event)
+{
+    if(event->type() == InitEvent)
+    {
+        init();
+        return true;
+    }
+    else if(event->type() == RenderEvent)
+    {
+        render();
+        return true;
+    }
+    else if(event->type() == RepeatEvent)
+    {
+        repeat();
+        return true;
+    }
+    else if(event->type() == StopEvent)
+    {
+        cleanup();
+        return true;
+    }
+
+    return QObject::event(event);
+}
+
+void RenderWorker::init()
+{
+    m_renderer->m_context->makeCurrent(m_renderer->m_offscreenSurface);
+    m_renderer->m_renderControl->initialize(m_renderer->m_context);
+}
+
+void RenderWorker::render()
+{
+    QMutexLocker lock(&m_renderer->m_mutex);
+
+    if(!m_renderer->m_context->makeCurrent(m_renderer->m_offscreenSurface))
+    {
+        m_renderer->m_busy.storeRelease(0);
+        m_renderer->m_synced = true;
+        m_renderer->m_condition.wakeOne();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if(!m_fbo || m_fbo->size() != m_renderer->m_outputSize)
+    {
+        delete m_fbo;
+        m_fbo = new QOpenGLFramebufferObject(m_renderer->m_outputSize, QOpenGLFramebufferObject::CombinedDepthStencil);
+        m_renderer->m_quickWindow->setRenderTarget(m_fbo);
+    }
+
+    m_renderer->m_renderControl->sync();
+
+    // The GUI thread only has to wait for the sync, rendering runs in parallel with it
+    m_renderer->m_synced = true;
+    m_renderer->m_condition.wakeOne();
+    lock.unlock();
+
+    m_renderer->m_renderControl->render();
+    m_renderer->m_quickWindow->resetOpenGLState();
+    m_renderer->m_context->functions()->glFlush();
+
+    QImage frame = m_fbo->toImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const qint64 renderTime = timer.nsecsElapsed();
+    m_renderer->m_frameCount.fetchAndAddOrdered(1);
+    m_renderer->m_totalRenderTime.fetchAndAddOrdered(renderTime);
+    m_renderer->m_stats.addFrameTime(renderTime);
+
+    {
+        QMutexLocker frameLock(&m_renderer->m_frameMutex);
+        m_renderer->m_frame = frame;
+    }
+
+    emit m_renderer->frameRendered(frame);
+
+    m_renderer->m_busy.storeRelease(0);
+}
+
+void RenderWorker::repeat()
+{
+    // Published from here like a rendered frame, so the direct connected
+    // sinks never run on the GUI thread
+    emit m_renderer->frameRendered(m_renderer->currentFrame());
+
+    m_renderer->m_busy.storeRelease(0);
+}
+
+void RenderWorker::cleanup()
+{
+    QMutexLocker lock(&m_renderer->m_mutex);
+
+    m_renderer->m_context->makeCurrent(m_renderer->m_offscreenSurface);
+    m_renderer->m_renderControl->invalidate();
+
+    delete m_fbo;
+    m_fbo = 0;
+
+    m_renderer->m_context->doneCurrent();
+    m_renderer->m_context->moveToThread(QCoreApplication::instance()->thread());
+
+    m_renderer->m_synced = true;
+    m_renderer->m_condition.wakeOne();
+}
+
+static int countPaintedItems(QQuickItem *item)
+{
+    if(!item->isVisible() || item->opacity() <= 0)
+    {
+        return 0;
+    }
+
+    int count = (item->flags() & QQuickItem::ItemHasContents) ? 1 : 0;
+
+    foreach(QQuickItem *child, item->childItems())
+    {
+        count += countPaintedItems(child);
+    }
+
+    return count;
+}
+
+Renderer::Renderer(QObject *parent) :
+    QObject(parent), m_synced(false), m_busy(0), m_outputSize(1920, 1080), m_dirty(true),
+    m_frameCount(0), m_totalRenderTime(0)
+{
+    QSurfaceFormat format;
+    format.setDepthBufferSize(16);
+    format.setStencilBufferSize(8);
+    format.setAlphaBufferSize(8);
+
+    m_context = new QOpenGLContext;
+    m_context->setFormat(format);
+
+    if(!m_context->create())
+    {
+        qDebug() << "Failed to create an OpenGL context for the renderer";
+    }
+
+    m_offscreenSurface = new QOffscreenSurface;
+    m_offscreenSurface->setFormat(m_context->format());
+    m_offscreenSurface->create();
+
+    m_renderControl = new QQuickRenderControl(this);
+    m_quickWindow = new QQuickWindow(m_renderControl);
+    m_quickWindow->setColor(Qt::transparent);
+    m_quickWindow->setGeometry(0, 0, m_outputSize.width(), m_outputSize.height());
+    m_quickWindow->contentItem()->setSize(m_outputSize);
+
+    connect(m_renderControl, SIGNAL(renderRequested()),
+            this, SLOT(invalidate()));
+    connect(m_renderControl, SIGNAL(sceneChanged()),
+            this, SLOT(invalidate()));
+
+    m_renderThread = new QThread(this);
+    m_renderThread->setObjectName("QuickCG render thread");
+    m_worker = new RenderWorker(this);
+
+    m_renderControl->prepareThread(m_renderThread);
+    m_context->moveToThread(m_renderThread);
+    m_worker->moveToThread(m_renderThread);
+    m_renderThread->start();
+
+    QCoreApplication::postEvent(m_worker, new QEvent(InitEvent));
+}
+
+Renderer::~Renderer()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_synced = false;
+        QCoreApplication::postEvent(m_worker, new QEvent(StopEvent));
+
+        while(!m_synced)
+        {
+            m_condition.wait(&m_mutex);
+        }
+    }
+
+    m_renderThread->quit();
+    m_renderThread->wait();
+
+    delete m_worker;
+    delete m_quickWindow;
+    delete m_renderControl;
+    delete m_offscreenSurface;
+    delete m_context;
+}
+
+QQuickItem* Renderer::rootItem() const
+{
+    return m_quickWindow->contentItem();
+}
+
+void Renderer::setRenderThreadPriority(QThread::Priority priority)
+{
+    m_renderThread->setPriority(priority);
+}
+
+void Renderer::setOutputSize(const QSize &size)
+{
+    if(size.isEmpty() || size == m_outputSize)
+    {
+        return;
+    }
+
+    // The render thread picks the new size up on its next frame
+    QMutexLocker lock(&m_mutex);
+    m_outputSize = size;
+    m_quickWindow->setGeometry(0, 0, size.width(), size.height());
+    m_quickWindow->contentItem()->setSize(size);
+    m_dirty = true;
+}
+
+QImage Renderer::currentFrame() const
+{
+    QMutexLocker lock(&m_frameMutex);
+
+    return m_frame;
+}
+
+void Renderer::renderFrame()
+{
+    if(!m_busy.testAndSetAcquire(0, 1))
+    {
+        // The previous frame is still being rendered and goes out late
+        m_stats.addLateFrame();
+        emit frameLate();
+        return;
+    }
+
+    if(!m_dirty)
+    {
+        // Nothing changed since the last tick, the render thread hands out the
+        // previous frame again and clears the busy flag
+        emit frameRepeated();
+        QCoreApplication::postEvent(m_worker, new QEvent(RepeatEvent));
+        return;
+    }
+
+    m_dirty = false;
+
+    m_renderControl->polishItems();
+    m_stats.addPaintedItems(countPaintedItems(m_quickWindow->contentItem()));
+
+    // Block until the render thread has synchronized the scene graph
+    QMutexLocker lock(&m_mutex);
+    m_synced = false;
+    QCoreApplication::postEvent(m_worker, new QEvent(RenderEvent));
+
+    // Guards against spurious wakeups
+    while(!m_synced)
+    {
+        m_condition.wait(&m_mutex);
+    }
+}
@@ -0,0 +1,102 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+#include <QThread>
+
+#include "renderstats.h"
+
+class QQuickRenderControl;
+class QQuickWindow;
+class QQuickItem;
+class QOpenGLContext;
+class QOffscreenSurface;
+class RenderWorker;
+
+// Renders a QtQuick scene offscreen through QQuickRenderControl. Polishing
+// happens on the GUI thread, while the scene graph is synchronized,
+// rendered and read back on a dedicated render thread.
+class Renderer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Renderer(QObject *parent = 0);
+    ~Renderer();
+
+    QQuickWindow* window() const { return m_quickWindow; }
+    QQuickItem* rootItem() const;
+
+    void setOutputSize(const QSize &size);
+    QSize outputSize() const { return m_outputSize; }
+
+    QImage currentFrame() const;
+
+    void setRenderThreadPriority(QThread::Priority priority);
+
+    bool isBusy() const { return m_busy.loadAcquire() != 0; }
+
+    RenderStats* stats() { return &m_stats; }
+
+    quint64 frameCount() const { return m_frameCount.loadAcquire(); }
+    qint64 totalRenderTime() const { return m_totalRenderTime.loadAcquire(); }
+
+public slots:
+    void renderFrame();
+    void invalidate() { m_dirty = true; }
+
+private:
+    QQuickRenderControl *m_renderControl;
+    QQuickWindow *m_quickWindow;
+    QOpenGLContext *m_context;
+    QOffscreenSurface *m_offscreenSurface;
+
+    QThread *m_renderThread;
+    RenderWorker *m_worker;
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    // Set under m_mutex by the render thread before it wakes the GUI thread
+    bool m_synced;
+    QAtomicInt m_busy;
+
+    QSize m_outputSize;
+    bool m_dirty;
+
+    mutable QMutex m_frameMutex;
+    QImage m_frame;
+
+    RenderStats m_stats;
+
+    QAtomicInteger<quint64> m_frameCount;
+    QAtomicInteger<qint64> m_totalRenderTime;
+
+signals:
+    // Emitted from the render thread, sinks that can handle that should use a direct connection
+    void frameRendered(const QImage &frame);
+    void frameRepeated();
+    void frameLate();
+
+    friend class RenderWorker;
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,126 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "renderstats.h"
+
+RenderStats::RenderStats()
+{
+    reset();
+}
+
+void RenderStats::addFrameTime(qint64 nsecs)
+{
+    int bucket = qBound(0, int(nsecs / BucketWidth), BucketCount - 1);
+    m_frameTimeBuckets[bucket].fetchAndAddRelaxed(1);
+    m_totalFrameTime.fetchAndAddRelaxed(nsecs);
+
+    qint64 max = m_maxFrameTime.loadAcquire();
+
+    while(nsecs > max && !m_maxFrameTime.testAndSetOrdered(max, nsecs))
+    {
+        max = m_maxFrameTime.loadAcquire();
+    }
+
+    m_renderedFrames.fetchAndAddRelease(1);
+}
+
+void RenderStats::addPaintedItems(int count)
+{
+    m_lastPaintedItems.storeRelease(count);
+    m_totalPaintedItems.fetchAndAddRelaxed(count);
+
+    if(count > m_maxPaintedItems.loadAcquire())
+    {
+        m_maxPaintedItems.storeRelease(count);
+    }
+
+    m_paintedFrames.fetchAndAddRelease(1);
+}
+
+void RenderStats::reset()
+{
+    for(int i = 0; i < BucketCount; ++i)
+    {
+        m_frameTimeBuckets[i].storeRelease(0);
+    }
+
+    m_renderedFrames.storeRelease(0);
+    m_totalFrameTime.storeRelease(0);
+    m_maxFrameTime.storeRelease(0);
+
+    m_paintedFrames.storeRelease(0);
+    m_totalPaintedItems.storeRelease(0);
+    m_lastPaintedItems.storeRelease(0);
+    m_maxPaintedItems.storeRelease(0);
+
+    m_propertyUpdates.storeRelease(0);
+    m_stateChanges.storeRelease(0);
+    m_lateFrames.storeRelease(0);
+}
+
+double RenderStats::frameTimePercentile(double percentile) const
+{
+    // Upper edge of the bucket holding the percentile, in milliseconds
+    quint64 total = 0;
+
+    for(int i = 0; i < BucketCount; ++i)
+    {
+        total += m_frameTimeBuckets[i].loadAcquire();
+    }
+
+    if(total == 0)
+    {
+        return 0;
+    }
+
+    quint64 target = quint64(qMax(1.0, total * percentile / 100.0 + 0.5));
+    quint64 count = 0;
+
+    for(int i = 0; i < BucketCount; ++i)
+    {
+        count += m_frameTimeBuckets[i].loadAcquire();
+
+        if(count >= target)
+        {
+            return (i + 1) * BucketWidth / 1000000.0;
+        }
+    }
+
+    return maxFrameTime();
+}
+
+double RenderStats::meanFrameTime() const
+{
+    quint64 frames = renderedFrames();
+
+    if(frames == 0)
+    {
+        return 0;
+    }
+
+    return m_totalFrameTime.loadAcquire() / 1000000.0 / frames;
+}
+
+double RenderStats::meanPaintedItems() const
+{
+    quint64 frames = paintedFrames();
+
+    if(frames == 0)
+    {
+        return 0;
+    }
+
+    return double(m_totalPaintedItems.loadAcquire()) / frames;
+}
@@ -0,0 +1,71 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+// Lock free counters and a frame time histogram that can be updated from
+// the render thread and read from anywhere.
+class RenderStats
+{
+public:
+    RenderStats();
+
+    static const int BucketCount = 1000;
+    static const qint64 BucketWidth = 100000; // 0.1 ms
+
+    void addFrameTime(qint64 nsecs);
+    void addPaintedItems(int count);
+    void addPropertyUpdates(int count) { m_propertyUpdates.fetchAndAddRelaxed(count); }
+    void addStateChanges(int count) { m_stateChanges.fetchAndAddRelaxed(count); }
+    // A tick found the renderer still busy with the previous frame
+    void addLateFrame() { m_lateFrames.fetchAndAddRelaxed(1); }
+
+    void reset();
+
+    quint64 renderedFrames() const { return m_renderedFrames.loadAcquire(); }
+    double frameTimePercentile(double percentile) const;
+    double meanFrameTime() const;
+    double maxFrameTime() const { return m_maxFrameTime.loadAcquire() / 1000000.0; }
+
+    quint64 paintedFrames() const { return m_paintedFrames.loadAcquire(); }
+    int lastPaintedItems() const { return m_lastPaintedItems.loadAcquire(); }
+    int maxPaintedItems() const { return m_maxPaintedItems.loadAcquire(); }
+    double meanPaintedItems() const;
+
+    quint64 propertyUpdates() const { return m_propertyUpdates.loadAcquire(); }
+    quint64 stateChanges() const { return m_stateChanges.loadAcquire(); }
+    quint64 lateFrames() const { return m_lateFrames.loadAcquire(); }
+
+private:
+    QAtomicInt m_frameTimeBuckets[BucketCount];
+    QAtomicInteger<quint64> m_renderedFrames;
+    QAtomicInteger<qint64> m_totalFrameTime;
+    QAtomicInteger<qint64> m_maxFrameTime;
+
+    QAtomicInteger<quint64> m_paintedFrames;
+    QAtomicInteger<quint64> m_totalPaintedItems;
+    QAtomicInt m_lastPaintedItems;
+    QAtomicInt m_maxPaintedItems;
+
+    QAtomicInteger<quint64> m_propertyUpdates;
+    QAtomicInteger<quint64> m_stateChanges;
+    QAtomicInteger<quint64> m_lateFrames;
+};
+
+#endif // RENDERSTATS_H
@@ -0,0 +1,398 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "rundown.h"
+#include "show.h"
+#include "timerwheel.h"
+#include "frameclock.h"
+
+#include <QDomDocument>
+#include <QDomElement>
+#include <QDebug>
+
+static bool actionLessThan(const Rundown::Action &a, const Rundown::Action &b)
+{
+    return a.time < b.time;
+}
+
+Rundown::Rundown(Show *show, TimerWheel *wheel, FrameClock *clock) :
+    QObject(show), m_show(show), m_wheel(wheel), m_clock(clock), m_state(StoppedState), m_next(0),
+    m_startFrame(0), m_numerator(clock->frameRateNumerator()), m_denominator(clock->frameRateDenominator()), m_pausedFrame(0), m_timerId(0), m_dueFrame(0),
+    m_executedActions(0), m_lateActions(0), m_lastJitter(0), m_maxJitter(0), m_totalJitter(0)
+{
+    connect(m_wheel, SIGNAL(rebased(quint64,quint64)),
+            this, SLOT(rebase(quint64,quint64)));
+}
+
+Rundown::~Rundown()
+{
+    m_wheel->cancel(m_timerId);
+}
+
+QString Rundown::typeName(Type type)
+{
+    switch(type)
+    {
+    case ClearAction:
+        return "clear";
+    case SetPropertiesAction:
+        return "set";
+    case ClearGroupAction:
+        return "clear group";
+    case ClearAllAction:
+        return "clear all";
+    default:
+        return "take";
+    }
+}
+
+bool Rundown::typeFromName(const QString &name, Type *type)
+{
+    QString lowerName = name.toLower();
+
+    if(lowerName == "take")
+    {
+        *type = TakeAction;
+    }
+    else if(lowerName == "clear")
+    {
+        *type = ClearAction;
+    }
+    else if(lowerName == "set")
+    {
+        *type = SetPropertiesAction;
+    }
+    else if(lowerName == "clear group")
+    {
+        *type = ClearGroupAction;
+    }
+    else if(lowerName == "clear all")
+    {
+        *type = ClearAllAction;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+QString Rundown::stateName(State state)
+{
+    switch(state)
+    {
+    case RunningState:
+        return "running";
+    case PausedState:
+        return "paused";
+    default:
+        return "stopped";
+    }
+}
+
+void Rundown::setActions(const QList<Action> &actions)
+{
+    stop();
+
+    m_actions = actions;
+    qStableSort(m_actions.begin(), m_actions.end(), actionLessThan);
+
+    emit statusChanged();
+}
+
+void Rundown::load(const QDomElement &element)
+{
+    QList<Action> actions;
+    QDomElement actionElement = element.firstChildElement("Action");
+
+    while(!actionElement.isNull())
+    {
+        Action action;
+        action.time = actionElement.attribute("time").toLongLong();
+        action.graphic = actionElement.attribute("graphic");
+        action.group = actionElement.attribute("group");
+
+        if(!typeFromName(actionElement.attribute("type"), &action.type))
+        {
+            qDebug() << "Skipping rundown action with unknown type" << actionElement.attribute("type");
+            actionElement = actionElement.nextSiblingElement("Action");
+            continue;
+        }
+
+        QDomElement propertyElement = actionElement.firstChildElement("Property");
+
+        while(!propertyElement.isNull())
+        {
+            QString propertyName = propertyElement.attribute("name");
+
+            if(!propertyName.isEmpty())
+            {
+                action.properties.append(QPair<QByteArray, QVariant>(propertyName.toLocal8Bit(), propertyElement.attribute("value")));
+            }
+
+            propertyElement = propertyElement.nextSiblingElement("Property");
+        }
+
+        actions.append(action);
+        actionElement = actionElement.nextSiblingElement("Action");
+    }
+
+    setActions(actions);
+}
+
+QDomElement Rundown::save(QDomDocument *doc) const
+{
+    QDomElement element = doc->createElement("Rundown");
+
+    foreach(const Action &action, m_actions)
+    {
+        QDomElement actionElement = doc->createElement("Action");
+        actionElement.setAttribute("time", action.time);
+        actionElement.setAttribute("type", typeName(action.type));
+
+        if(!action.graphic.isEmpty())
+        {
+            actionElement.setAttribute("graphic", action.graphic);
+        }
+
+        if(!action.group.isEmpty())
+        {
+            actionElement.setAttribute("group", action.group);
+        }
+
+        for(int i = 0; i < action.properties.count(); ++i)
+        {
+            QDomElement propertyElement = doc->createElement("Property");
+            propertyElement.setAttribute("name", QString(action.properties.at(i).first));
+            propertyElement.setAttribute("value", action.properties.at(i).second.toString());
+            actionElement.appendChild(propertyElement);
+        }
+
+        element.appendChild(actionElement);
+    }
+
+    return element;
+}
+
+qint64 Rundown::actionFrame(const Action &action) const
+{
+    return m_startFrame + qint64(m_wheel->framesFromMsecs(action.time));
+}
+
+qint64 Rundown::position() const
+{
+    if(m_state == StoppedState)
+    {
+        return 0;
+    }
+
+    qint64 frame = m_state == PausedState ? qint64(m_pausedFrame) : qint64(m_wheel->currentFrame());
+    qint64 frames = qMax(qint64(0), frame - m_startFrame);
+
+    return frames * 1000 * m_clock->frameRateDenominator() / m_clock->frameRateNumerator();
+}
+
+double Rundown::meanJitter() const
+{
+    return m_executedActions > 0 ? m_totalJitter / m_executedActions : 0;
+}
+
+void Rundown::arm(qint64 from)
+{
+    stop();
+
+    if(m_actions.isEmpty())
+    {
+        return;
+    }
+
+    // Time 0 is the next frame, or earlier when starting part way through
+    m_startFrame = qint64(m_wheel->currentFrame()) + 1 - qint64(m_wheel->framesFromMsecs(from));
+    m_numerator = m_clock->frameRateNumerator();
+    m_denominator = m_clock->frameRateDenominator();
+
+    m_next = 0;
+
+    while(m_next < m_actions.count() && m_actions.at(m_next).time < from)
+    {
+        ++m_next;
+    }
+
+    m_executedActions = 0;
+    m_lateActions = 0;
+    m_lastJitter = 0;
+    m_maxJitter = 0;
+    m_totalJitter = 0;
+
+    setState(RunningState);
+    scheduleNext();
+}
+
+void Rundown::pause()
+{
+    if(m_state != RunningState)
+    {
+        return;
+    }
+
+    m_wheel->cancel(m_timerId);
+    m_timerId = 0;
+    m_pausedFrame = m_wheel->currentFrame();
+
+    setState(PausedState);
+}
+
+void Rundown::resume()
+{
+    if(m_state != PausedState)
+    {
+        return;
+    }
+
+    // The remaining actions keep their distance to the paused position
+    m_startFrame += qint64(m_wheel->currentFrame() - m_pausedFrame);
+
+    setState(RunningState);
+    scheduleNext();
+}
+
+void Rundown::stop()
+{
+    m_wheel->cancel(m_timerId);
+    m_timerId = 0;
+    m_next = 0;
+    setState(StoppedState);
+}
+
+void Rundown::rebase(quint64 previousFrame, quint64 frame)
+{
+    if(m_state == StoppedState)
+    {
+        return;
+    }
+
+    // Keep the position in time, the frame rate may have changed with the restart
+    qint64 reference = m_state == PausedState ? qint64(m_pausedFrame) : qint64(previousFrame);
+    qint64 position = (reference - m_startFrame) * 1000 * m_denominator / m_numerator;
+
+    m_numerator = m_clock->frameRateNumerator();
+    m_denominator = m_clock->frameRateDenominator();
+
+    if(position >= 0)
+    {
+        m_startFrame = qint64(frame) - qint64(m_wheel->framesFromMsecs(position));
+    }
+    else
+    {
+        m_startFrame = qint64(frame) + qint64(m_wheel->framesFromMsecs(-position));
+    }
+
+    if(m_state == PausedState)
+    {
+        m_pausedFrame = frame;
+        return;
+    }
+
+    // The wheel kept the frames left, not the time left
+    m_wheel->cancel(m_timerId);
+    m_timerId = 0;
+    scheduleNext();
+}
+
+void Rundown::scheduleNext()
+{
+    if(m_next >= m_actions.count())
+    {
+        // Finished, the statistics stay until the next arm()
+        m_timerId = 0;
+        setState(StoppedState);
+        m_next = m_actions.count();
+        return;
+    }
+
+    qint64 frame = qMax(actionFrame(m_actions.at(m_next)), qint64(m_wheel->currentFrame()) + 1);
+    m_dueFrame = quint64(frame);
+    m_timerId = m_wheel->schedule(m_dueFrame, this, "executeDueActions");
+}
+
+void Rundown::executeDueActions()
+{
+    m_timerId = 0;
+
+    quint64 frame = m_wheel->currentFrame();
+    double jitter = double(m_clock->elapsed() - m_clock->frameTime(m_dueFrame)) / 1000000.0;
+    bool late = frame > m_dueFrame;
+
+    while(m_next < m_actions.count() && actionFrame(m_actions.at(m_next)) <= qint64(frame))
+    {
+        execute(m_actions.at(m_next));
+        ++m_next;
+
+        ++m_executedActions;
+        m_lateActions += late ? 1 : 0;
+        m_lastJitter = jitter;
+        m_maxJitter = qMax(m_maxJitter, jitter);
+        m_totalJitter += jitter;
+    }
+
+    scheduleNext();
+
+    emit statusChanged();
+}
+
+void Rundown::execute(const Action &action)
+{
+    if(action.type != ClearGroupAction && action.type != ClearAllAction && !m_show->graphicFromName(action.graphic))
+    {
+        qDebug() << "Rundown action" << typeName(action.type) << "at" << action.time << "ms refers to unknown graphic" << action.graphic;
+        return;
+    }
+
+    switch(action.type)
+    {
+    case TakeAction:
+        m_show->setGraphicOnAir(action.graphic, true);
+        break;
+    case ClearAction:
+        m_show->setGraphicOnAir(action.graphic, false);
+        break;
+    case SetPropertiesAction:
+    {
+        Show::GraphicUpdate update;
+        update.graphic = action.graphic;
+        update.properties = action.properties;
+        m_show->commitTransaction(QList<Show::GraphicUpdate>() << update);
+        break;
+    }
+    case ClearGroupAction:
+        m_show->clearGroup(action.group);
+        break;
+    case ClearAllAction:
+        m_show->clearAll();
+        break;
+    }
+}
+
+void Rundown::setState(State state)
+{
+    if(state == m_state)
+    {
+        return;
+    }
+
+    m_state = state;
+    emit statusChanged();
+}
@@ -0,0 +1,137 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RUNDOWN_H
+#define RUNDOWN_H
+
+#include <QObject>
+#include <QList>
+#include <QPair>
+#include <QVariant>
+#include <QStringList>
+
+class QDomDocument;
+class QDomElement;
+class Show;
+class TimerWheel;
+class FrameClock;
+
+// Timed actions of a show, run by the server against the frame clock.
+// Times are offsets from the moment the rundown is armed. Each action is
+// scheduled on the timer wheel for the frame its offset rounds up to, so
+// it is applied together with that frame. The delay between the ideal
+// time of that frame and the moment the action actually ran is recorded
+// as the execution jitter.
+class Rundown : public QObject
+{
+    Q_OBJECT
+public:
+    enum Type
+    {
+        TakeAction,
+        ClearAction,
+        SetPropertiesAction,
+        ClearGroupAction,
+        ClearAllAction
+    };
+
+    enum State
+    {
+        StoppedState,
+        RunningState,
+        PausedState
+    };
+
+    struct Action
+    {
+        Action() : time(0), type(TakeAction) {}
+
+        qint64 time; // ms
+        Type type;
+        QString graphic;
+        QString group;
+        QList<QPair<QByteArray, QVariant> > properties;
+    };
+
+    Rundown(Show *show, TimerWheel *wheel, FrameClock *clock);
+    ~Rundown();
+
+    static QString typeName(Type type);
+    static bool typeFromName(const QString &name, Type *type);
+    static QString stateName(State state);
+
+    // Kept sorted by time, actions with the same time run in the given order
+    void setActions(const QList<Action> &actions);
+    QList<Action> actions() const { return m_actions; }
+
+    void load(const QDomElement &element);
+    QDomElement save(QDomDocument *doc) const;
+
+    State state() const { return m_state; }
+    // Index of the next action to run, the number of actions once finished
+    int nextAction() const { return m_next; }
+    qint64 position() const;
+
+    int executedActions() const { return m_executedActions; }
+    int lateActions() const { return m_lateActions; }
+    double lastJitter() const { return m_lastJitter; }
+    double maxJitter() const { return m_maxJitter; }
+    double meanJitter() const;
+
+public slots:
+    void arm(qint64 from = 0);
+    void pause();
+    void resume();
+    void stop();
+
+protected slots:
+    void executeDueActions();
+    void rebase(quint64 previousFrame, quint64 frame);
+
+protected:
+    void execute(const Action &action);
+    void scheduleNext();
+    void setState(State state);
+    qint64 actionFrame(const Action &action) const;
+
+private:
+    Show *m_show;
+    TimerWheel *m_wheel;
+    FrameClock *m_clock;
+
+    QList<Action> m_actions;
+    State m_state;
+    int m_next;
+
+    // The frame at time 0, moved on by pauses
+    qint64 m_startFrame;
+    // Frame rate m_startFrame was counted in
+    int m_numerator;
+    int m_denominator;
+    quint64 m_pausedFrame;
+    int m_timerId;
+    quint64 m_dueFrame;
+
+    int m_executedActions;
+    int m_lateActions;
+    double m_lastJitter; // ms
+    double m_maxJitter;
+    double m_totalJitter;
+
+signals:
+    void statusChanged();
+};
+
+#endif // RUNDOWN_H
@@ -0,0 +1,120 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "scaledoutput.h"
+#include "downscaler.h"
+#include "framering.h"
+
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QRegExp>
+
+class ScaleTask : public QRunnable
+{
+public:
+    ScaleTask(ScaledOutput *output, const QImage &frame) :
+        m_output(output), m_frame(frame)
+    {
+    }
+
+    void run()
+    {
+        m_output->scaleFrame(m_frame);
+    }
+
+private:
+    ScaledOutput *m_output;
+    QImage m_frame;
+};
+
+ScaledOutput::ScaledOutput(const QSize &size, QObject *parent) :
+    QObject(parent), m_size(size), m_target(size, QImage::Format_ARGB32_Premultiplied)
+{
+    m_frameRing = new FrameRing(this);
+    m_pool.setMaxThreadCount(1);
+}
+
+ScaledOutput::~ScaledOutput()
+{
+    m_pool.waitForDone();
+}
+
+bool ScaledOutput::parseSize(const QString &text, QSize *size)
+{
+    QRegExp regexp("^(\\d+)x(\\d+)$");
+
+    if(!regexp.exactMatch(text.trimmed()))
+    {
+        return false;
+    }
+
+    QSize parsed(regexp.cap(1).toInt(), regexp.cap(2).toInt());
+
+    if(parsed.isEmpty())
+    {
+        return false;
+    }
+
+    *size = parsed;
+
+    return true;
+}
+
+bool ScaledOutput::open(const QString &name)
+{
+    return m_frameRing->open(name, m_size);
+}
+
+double ScaledOutput::meanScaleTime() const
+{
+    quint64 frames = scaledFrames();
+
+    if(frames == 0)
+    {
+        return 0;
+    }
+
+    return m_totalScaleTime.loadAcquire() / 1000000.0 / frames;
+}
+
+void ScaledOutput::addFrame(const QImage &frame)
+{
+    if(!m_busy.testAndSetAcquire(0, 1))
+    {
+        m_droppedFrames.fetchAndAddRelaxed(1);
+        return;
+    }
+
+    // The image is implicitly shared, the task only holds a reference
+    m_pool.start(new ScaleTask(this, frame));
+}
+
+void ScaledOutput::scaleFrame(const QImage &frame)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Downscaler::scale(frame, &m_target);
+
+    m_totalScaleTime.fetchAndAddRelaxed(timer.nsecsElapsed());
+    m_scaledFrames.fetchAndAddRelease(1);
+
+    if(m_frameRing->isOpen())
+    {
+        m_frameRing->writeFrame(m_target);
+    }
+
+    m_busy.storeRelease(0);
+}
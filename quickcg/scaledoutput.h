@@ -0,0 +1,72 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SCALEDOUTPUT_H
+#define SCALEDOUTPUT_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+class FrameRing;
+
+// A secondary output that gets the channel's full resolution frames
+// downscaled on its own worker thread. If the previous frame is still
+// being scaled when a new one arrives the new one is dropped, the
+// render thread never waits.
+class ScaledOutput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScaledOutput(const QSize &size, QObject *parent = 0);
+    ~ScaledOutput();
+
+    static bool parseSize(const QString &text, QSize *size);
+
+    QSize size() const { return m_size; }
+    FrameRing* frameRing() const { return m_frameRing; }
+
+    bool open(const QString &name);
+
+    quint64 scaledFrames() const { return m_scaledFrames.loadAcquire(); }
+    quint64 droppedFrames() const { return m_droppedFrames.loadAcquire(); }
+    double meanScaleTime() const;
+
+public slots:
+    // Called from the render thread
+    void addFrame(const QImage &frame);
+
+protected:
+    void scaleFrame(const QImage &frame);
+
+private:
+    QSize m_size;
+    QImage m_target;
+    FrameRing *m_frameRing;
+
+    QThreadPool m_pool;
+    QAtomicInt m_busy;
+
+    QAtomicInteger<quint64> m_scaledFrames;
+    QAtomicInteger<quint64> m_droppedFrames;
+    QAtomicInteger<qint64> m_totalScaleTime;
+
+    friend class ScaleTask;
+};
+
+#endif // SCALEDOUTPUT_H
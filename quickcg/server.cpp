@@ -43,46 +43,134 @@ void Server::createClientConnection()
     }
 }
 
-void Server::sendGraphicAdded(const QString& graphic)
+void Server::sendGraphicAdded(int channel, const QString& graphic)
 {
     for (int i = 0; i < m_connections.count(); ++i)
     {
         if(m_connections[i])
         {
-            m_connections[i]->sendGraphicAdded(graphic);
+            m_connections[i]->sendGraphicAdded(channel, graphic);
         }
     }
 }
 
-void Server::sendGraphicRemoved(const QString& graphic)
+void Server::sendGraphicRemoved(int channel, const QString& graphic)
 {
     for (int i = 0; i < m_connections.count(); ++i)
     {
         if(m_connections[i])
         {
-            m_connections[i]->sendGraphicRemoved(graphic);
+            m_connections[i]->sendGraphicRemoved(channel, graphic);
         }
     }
 }
 
-void Server::sendShowList()
+void Server::sendShowList(int channel)
 {
     for(int i = 0; i < m_connections.count(); ++i)
     {
         if(m_connections[i])
         {
-            m_connections[i]->sendShowList();
+            m_connections[i]->sendShowList(channel);
         }
     }
 }
 
-void Server::sendGraphicStateChanged(const QString &graphic, bool state)
+void Server::sendGraphicStateChanged(int channel, const QString &graphic, int state)
 {
     for(int i = 0; i < m_connections.count(); ++i)
     {
         if(m_connections[i])
         {
-            m_connections[i]->sendGraphicStateChanged(graphic, state);
+            m_connections[i]->sendGraphicStateChanged(channel, graphic, state);
+        }
+    }
+}
+
+void Server::sendGraphicCued(int channel, const QString &graphic, bool ready)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendGraphicCued(channel, graphic, ready);
+        }
+    }
+}
+
+void Server::sendGraphicsCleared(int channel, const QString &group, const QStringList &graphics)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendGraphicsCleared(channel, group, graphics);
+        }
+    }
+}
+
+void Server::sendRundownStatus(int channel)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendRundownStatus(channel);
+        }
+    }
+}
+
+void Server::sendShowLoadProgress(int channel, const QString &show, int loaded, int total)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendShowLoadProgress(channel, show, loaded, total);
+        }
+    }
+}
+
+void Server::sendGraphicThumbnail(int channel, const QString &graphic, quint64 revision, const QByteArray &image)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendGraphicThumbnail(channel, graphic, revision, image);
+        }
+    }
+}
+
+void Server::sendRecordingStarted(const QString &path)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendRecordingStarted(path);
+        }
+    }
+}
+
+void Server::sendRecordingOverflow(quint64 framesDropped)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendRecordingOverflow(framesDropped);
+        }
+    }
+}
+
+void Server::sendRecordingFinished(const QString &path, quint64 framesWritten, quint64 framesDropped)
+{
+    for(int i = 0; i < m_connections.count(); ++i)
+    {
+        if(m_connections[i])
+        {
+            m_connections[i]->sendRecordingFinished(path, framesWritten, framesDropped);
         }
     }
 }
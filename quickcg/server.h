@@ -32,13 +32,24 @@ public:
 
     MainWindow *mainWindow() const { return m_mainWindow; }
 
-    void sendGraphicAdded(const QString& graphic);
-    void sendGraphicRemoved(const QString& graphic);
+    void sendGraphicAdded(int channel, const QString& graphic);
+    void sendGraphicRemoved(int channel, const QString& graphic);
 
-    void sendShowList();
+    void sendRecordingStarted(const QString &path);
 
 public slots:
-    void sendGraphicStateChanged(const QString &graphic, bool state);
+    void sendGraphicStateChanged(int channel, const QString &graphic, int state);
+    void sendGraphicCued(int channel, const QString &graphic, bool ready);
+    void sendGraphicsCleared(int channel, const QString &group, const QStringList &graphics);
+    void sendRundownStatus(int channel);
+
+    void sendShowList(int channel);
+    void sendShowLoadProgress(int channel, const QString &show, int loaded, int total);
+
+    void sendGraphicThumbnail(int channel, const QString &graphic, quint64 revision, const QByteArray &image);
+
+    void sendRecordingOverflow(quint64 framesDropped);
+    void sendRecordingFinished(const QString &path, quint64 framesWritten, quint64 framesDropped);
 
 protected slots:
     void createClientConnection();
@@ -15,6 +15,13 @@
 
 #include "show.h"
 #include "mainwindow.h"
+#include "channel.h"
+#include "renderstats.h"
+#include "thumbnailrenderer.h"
+#include "templateschema.h"
+#include "templatecache.h"
+#include "rundown.h"
+#include "datafeed.h"
 
 #include <QFile>
 #include <QDomDocument>
@@ -22,16 +29,30 @@
 #include <QDebug>
 #include <QUrl>
 #include <QDir>
-#include <QDeclarativeComponent>
+#include <QQmlComponent>
 #include <QFileInfo>
 
-Show::Show(MainWindow *mainWindow) :
-    QObject(mainWindow), m_mainWindow(mainWindow)
+Show::Show(Channel *channel) :
+    QObject(channel), m_loadedCount(0), m_loadTotal(0), m_evictionPending(false), m_cacheHits(0), m_cacheMisses(0), m_channel(channel), m_mainWindow(channel->mainWindow())
 {
+    m_rundown = new Rundown(this, m_mainWindow->timerWheel(), m_mainWindow->frameClock());
+    connect(m_rundown, SIGNAL(statusChanged()), this, SIGNAL(rundownStatusChanged()));
 }
 
 Show::~Show()
 {
+    // The rundown must not run against deleted graphics
+    delete m_rundown;
+
+    // Another show may use the same graphic names
+    if(m_mainWindow->thumbnailRenderer())
+    {
+        foreach(const QString &name, m_graphicHash.keys())
+        {
+            m_mainWindow->thumbnailRenderer()->remove(m_channel->id(), name);
+        }
+    }
+
     qDeleteAll(m_graphicHash);
 }
 
@@ -76,11 +97,89 @@ void Show::load(const QString &path)
         {
             loadGraphic(element);
         }
+        else if(element.tagName() == "Rundown")
+        {
+            m_rundown->load(element);
+        }
+        else if(element.tagName() == "FeedBinding")
+        {
+            loadFeedBinding(element);
+        }
 
         element = element.nextSiblingElement();
     }
 }
 
+void Show::loadFeedBinding(const QDomElement &element)
+{
+    FeedBinding binding;
+    binding.feed = element.attribute("feed");
+    binding.field = element.attribute("field");
+    binding.graphic = element.attribute("graphic");
+    binding.property = element.attribute("property").toLocal8Bit();
+
+    if(binding.feed.isEmpty() || binding.field.isEmpty() || binding.graphic.isEmpty() || binding.property.isEmpty())
+    {
+        qDebug() << "Skipping incomplete feed binding";
+        return;
+    }
+
+    m_feedBindings.append(binding);
+}
+
+void Show::setFeedBindings(const QList<FeedBinding> &bindings)
+{
+    m_feedBindings = bindings;
+
+    // New bindings start from the current values
+    m_feedSerials.clear();
+}
+
+void Show::applyFeedBindings()
+{
+    if(m_feedBindings.isEmpty())
+    {
+        return;
+    }
+
+    QHash<QString, quint64> serials;
+
+    foreach(const FeedBinding &binding, m_feedBindings)
+    {
+        DataFeed *feed = m_mainWindow->feed(binding.feed);
+
+        if(!feed)
+        {
+            continue;
+        }
+
+        serials.insert(binding.feed, feed->serial());
+
+        // A feed that was added again counts from zero
+        quint64 applied = m_feedSerials.value(binding.feed);
+
+        if(applied > feed->serial())
+        {
+            applied = 0;
+        }
+
+        // Only the latest value is copied, however many updates came in since the last frame
+        if(feed->fieldSerial(binding.field) <= applied)
+        {
+            continue;
+        }
+
+        Graphic *graphic = m_graphicHash.value(binding.graphic);
+
+        if(graphic)
+        {
+            graphic->setGraphicsProperty(binding.property, feed->value(binding.field));
+        }
+    }
+
+    m_feedSerials = serials;
+}
+
 void Show::loadGraphic(const QDomElement &element)
 {
     QString templateFile = element.attribute("template");
@@ -134,33 +233,387 @@ void Show::setGraphicOnAir(const QString &name, bool state)
 
     if(graphic)
     {
+        touchGraphic(graphic);
         graphic->setOnAir(state);
 
-        if(state && !graphic->group().isEmpty())
+        // Not taken if the graphic has no usable template
+        if(state && graphic->targetOnAir() && !graphic->group().isEmpty())
+        {
+            Graphic *previous = m_groupOnAir.value(graphic->group());
+
+            if(previous && previous != graphic && previous->targetOnAir())
+            {
+                previous->setOnAir(false);
+            }
+
+            m_groupOnAir.insert(graphic->group(), graphic);
+        }
+    }
+}
+
+QStringList Show::clearGroup(const QString &group)
+{
+    QStringList cleared;
+
+    foreach(Graphic *graphic, m_groupMembers.value(group))
+    {
+        if(graphic->targetOnAir())
+        {
+            graphic->setOnAir(false);
+            cleared.append(graphic->name());
+        }
+    }
+
+    m_groupOnAir.remove(group);
+
+    if(!cleared.isEmpty())
+    {
+        emit graphicsCleared(group, cleared);
+    }
+
+    return cleared;
+}
+
+QStringList Show::clearAll()
+{
+    QStringList cleared;
+
+    // Only graphics with an item can be on air
+    foreach(Graphic *graphic, m_materializedGraphics)
+    {
+        if(graphic->targetOnAir())
+        {
+            graphic->setOnAir(false);
+            cleared.append(graphic->name());
+        }
+    }
+
+    m_groupOnAir.clear();
+
+    if(!cleared.isEmpty())
+    {
+        emit graphicsCleared(QString(), cleared);
+    }
+
+    return cleared;
+}
+
+void Show::updateGroupIndex(Graphic *graphic, const QString &previous)
+{
+    if(!previous.isEmpty())
+    {
+        QHash<QString, QSet<Graphic*> >::iterator it = m_groupMembers.find(previous);
+
+        if(it != m_groupMembers.end())
         {
-            foreach(Graphic* other, m_graphicHash)
+            it->remove(graphic);
+
+            if(it->isEmpty())
             {
-                if(other != graphic && other->group() == graphic->group())
-                {
-                    other->setOnAir(false);
-                }
+                m_groupMembers.erase(it);
             }
         }
+
+        if(m_groupOnAir.value(previous) == graphic)
+        {
+            m_groupOnAir.remove(previous);
+        }
+    }
+
+    if(!graphic->group().isEmpty())
+    {
+        m_groupMembers[graphic->group()].insert(graphic);
+
+        if(graphic->targetOnAir() && !m_groupOnAir.contains(graphic->group()))
+        {
+            m_groupOnAir.insert(graphic->group(), graphic);
+        }
+    }
+}
+
+void Show::cueGraphic(const QString &name)
+{
+    Graphic *graphic = m_graphicHash.value(name);
+
+    if(!graphic)
+    {
+        return;
+    }
+
+    touchGraphic(graphic);
+    m_cueingGraphics.insert(graphic);
+    graphic->cue();
+}
+
+void Show::onGraphicPrepared(Graphic *graphic, bool ready)
+{
+    if(!m_cueingGraphics.remove(graphic))
+    {
+        return;
+    }
+
+    if(ready)
+    {
+        m_preparedGraphics.insert(graphic);
+    }
+    else
+    {
+        emit graphicCued(graphic->name(), false);
     }
 }
 
+bool Show::reportCuedGraphics()
+{
+    // Rendered with the previous frame, so glyphs and textures are uploaded
+    foreach(Graphic *graphic, m_renderedGraphics)
+    {
+        emit graphicCued(graphic->name(), true);
+    }
+
+    m_renderedGraphics.clear();
+
+    if(m_preparedGraphics.isEmpty())
+    {
+        return false;
+    }
+
+    m_renderedGraphics.swap(m_preparedGraphics);
+
+    return true;
+}
+
 bool Show::isGraphicOnAir(const QString &name) const
 {
     Graphic *graphic = m_graphicHash.value(name);
 
     if(graphic)
     {
-        return graphic->isOnAir();
+        return graphic->targetOnAir();
     }
 
     return false;
 }
 
+void Show::addPendingGraphic(Graphic *graphic)
+{
+    m_pendingGraphics.insert(graphic);
+}
+
+void Show::updateGraphicCache(Graphic *graphic, bool valid)
+{
+    // Only on air graphics are drawn, a layer that becomes valid on air is rasterized once
+    if(valid && graphic->isOnAir())
+    {
+        m_cachedGraphics.insert(graphic);
+        ++m_cacheMisses;
+    }
+    else
+    {
+        if(m_cachedGraphics.remove(graphic))
+        {
+            m_invalidatedGraphics.insert(graphic);
+        }
+    }
+}
+
+void Show::reloadTemplate(const QString &path)
+{
+    QSharedPointer<QQmlComponent> component;
+    QSharedPointer<const TemplateSchema> schema;
+
+    foreach(Graphic *graphic, m_graphicHash)
+    {
+        if(QFileInfo(m_mainWindow->templateDir().absoluteFilePath(graphic->templateName())).canonicalFilePath() != path)
+        {
+            continue;
+        }
+
+        if(!component)
+        {
+            component = m_mainWindow->templateCache()->component(path, &schema);
+
+            if(!component)
+            {
+                return;
+            }
+        }
+
+        graphic->reloadComponent(component, schema);
+    }
+}
+
+void Show::updateTemplateSchema(Graphic *graphic)
+{
+    QString path = QFileInfo(m_mainWindow->templateDir().absoluteFilePath(graphic->templateName())).canonicalFilePath();
+    m_mainWindow->templateCache()->updateSchema(path, graphic->component(), graphic->schema());
+}
+
+void Show::requestThumbnail(Graphic *graphic)
+{
+    m_mainWindow->thumbnailRenderer()->request(m_channel->id(), graphic);
+}
+
+void Show::addMaterializedGraphic(Graphic *graphic)
+{
+    m_materializedGraphics.append(graphic);
+    m_evictionPending = true;
+}
+
+void Show::touchGraphic(Graphic *graphic)
+{
+    if(m_materializedGraphics.removeOne(graphic))
+    {
+        m_materializedGraphics.append(graphic);
+    }
+}
+
+qint64 Show::itemMemoryEstimate() const
+{
+    qint64 size = 0;
+
+    foreach(Graphic *graphic, m_materializedGraphics)
+    {
+        size += graphic->memoryEstimate();
+    }
+
+    return size;
+}
+
+bool Show::evictIdleItems()
+{
+    qint64 budget = m_mainWindow->itemMemoryBudget();
+
+    if(!m_evictionPending || budget <= 0)
+    {
+        return false;
+    }
+
+    m_evictionPending = false;
+
+    qint64 size = itemMemoryEstimate();
+    bool evicted = false;
+    int i = 0;
+
+    // Graphics that are on air or busy are skipped, they may go on a later frame
+    while(size > budget && i < m_materializedGraphics.count())
+    {
+        Graphic *graphic = m_materializedGraphics.at(i);
+        qint64 graphicSize = graphic->memoryEstimate();
+
+        if(graphic->evict())
+        {
+            m_materializedGraphics.removeAt(i);
+            size -= graphicSize;
+            evicted = true;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    m_evictionPending = size > budget;
+
+    return evicted;
+}
+
+bool Show::processFrame(RenderStats *stats)
+{
+    bool created = createPendingItems();
+
+    // Queued with the other pending changes, so each graphic is still written once per frame
+    applyFeedBindings();
+
+    bool changed = applyPendingChanges(stats);
+    bool cued = reportCuedGraphics();
+
+    // A layer drawn from its cache this frame, rebuilt ones were counted as misses
+    foreach(Graphic *graphic, m_cachedGraphics)
+    {
+        if(!m_invalidatedGraphics.contains(graphic))
+        {
+            ++m_cacheHits;
+        }
+    }
+
+    m_invalidatedGraphics.clear();
+
+    return evictIdleItems() || cued || changed || created;
+}
+
+bool Show::commitTransaction(const QList<GraphicUpdate> &updates, QStringList *missing)
+{
+    bool complete = true;
+
+    foreach(const GraphicUpdate &update, updates)
+    {
+        if(!m_graphicHash.contains(update.graphic))
+        {
+            complete = false;
+
+            if(missing)
+            {
+                missing->append(update.graphic);
+            }
+        }
+    }
+
+    if(!complete)
+    {
+        return false;
+    }
+
+    // Everything is queued before the frame loop runs again, so all of it
+    // lands in applyPendingChanges() together
+    foreach(const GraphicUpdate &update, updates)
+    {
+        Graphic *graphic = m_graphicHash.value(update.graphic);
+
+        for(int i = 0; i < update.properties.count(); ++i)
+        {
+            graphic->setGraphicsProperty(update.properties.at(i).first, update.properties.at(i).second);
+        }
+
+        if(update.changeState)
+        {
+            setGraphicOnAir(update.graphic, update.onAir);
+        }
+    }
+
+    return true;
+}
+
+bool Show::applyPendingChanges(RenderStats *stats)
+{
+    if(m_pendingGraphics.isEmpty())
+    {
+        return false;
+    }
+
+    QSet<Graphic*> pending;
+    pending.swap(m_pendingGraphics);
+    bool changed = false;
+
+    int propertyUpdates = 0;
+    int stateChanges = 0;
+
+    foreach(Graphic *graphic, pending)
+    {
+        touchGraphic(graphic);
+        propertyUpdates += graphic->pendingPropertyCount();
+        stateChanges += graphic->hasPendingStateChange() ? 1 : 0;
+        changed |= graphic->applyPendingChanges();
+    }
+
+    if(stats)
+    {
+        stats->addPropertyUpdates(propertyUpdates);
+        stats->addStateChanges(stateChanges);
+    }
+
+    return changed;
+}
+
 Graphic *Show::createGraphic(const QString &name, const QString &templateName)
 {
     if(name.isEmpty())
@@ -175,53 +628,94 @@ Graphic *Show::createGraphic(const QString &name, const QString &templateName)
     }
 
     Graphic *graphic = new Graphic(name);
+    graphic->setTimerWheel(m_mainWindow->timerWheel());
     m_graphicHash.insert(name, graphic);
 
-    connect(graphic, SIGNAL(itemCreated(QDeclarativeItem*)), m_mainWindow, SLOT(addItem(QDeclarativeItem*)));
-    connect(graphic, SIGNAL(stateChanged(QString,bool)), this, SIGNAL(graphicStateChanged(QString,bool)));
+    connect(graphic, SIGNAL(itemCreated(QQuickItem*)), m_channel, SLOT(addItem(QQuickItem*)));
+    connect(graphic, SIGNAL(stateChanged(QString,int)), this, SIGNAL(graphicStateChanged(QString,int)));
+    connect(graphic, SIGNAL(changesPending(Graphic*)), this, SLOT(addPendingGraphic(Graphic*)));
+    connect(graphic, SIGNAL(cacheStateChanged(Graphic*,bool)), this, SLOT(updateGraphicCache(Graphic*,bool)));
+    connect(graphic, SIGNAL(revisionChanged(Graphic*)), this, SLOT(requestThumbnail(Graphic*)));
+    connect(graphic, SIGNAL(materialized(Graphic*)), this, SLOT(addMaterializedGraphic(Graphic*)));
+    connect(graphic, SIGNAL(prepared(Graphic*,bool)), this, SLOT(onGraphicPrepared(Graphic*,bool)));
+    connect(graphic, SIGNAL(groupChanged(Graphic*,QString)), this, SLOT(updateGroupIndex(Graphic*,QString)));
+    connect(graphic, SIGNAL(schemaRebuilt(Graphic*)), this, SLOT(updateTemplateSchema(Graphic*)));
+
+    graphic->setTemplateName(templateName);
 
-    graphic->setPropertyNames(parseGraphicProperties(templateName));
-    graphic->setComponent(m_mainWindow->loadTemplate(templateName));
+    // The template is compiled in the background and handed over on a later frame,
+    // the item itself is only created once the graphic is used
+    QString path = QFileInfo(m_mainWindow->templateDir().absoluteFilePath(templateName)).canonicalFilePath();
+
+    if(path.isEmpty())
+    {
+        qDebug() << "Failed to load graphic" << name << ", template" << templateName << "does not exist";
+        return graphic;
+    }
+
+    m_mainWindow->templateCache()->prefetch(path);
+    m_loadQueue.append(QPair<Graphic*, QString>(graphic, path));
+
+    if(m_loadTotal == 0)
+    {
+        m_progressTimer.start();
+    }
+
+    ++m_loadTotal;
 
     return graphic;
 }
 
-QStringList Show::parseGraphicProperties(const QString &name)
+bool Show::createPendingItems()
 {
-    QFile file(m_mainWindow->templateDir().absoluteFilePath(name));
-
-    if(!file.exists())
+    if(m_loadQueue.isEmpty())
     {
-        return QStringList();
+        return false;
     }
 
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    TemplateCache *cache = m_mainWindow->templateCache();
+    QElapsedTimer timer;
+    timer.start();
+    bool created = false;
+    int i = 0;
+
+    while(i < m_loadQueue.count() && (!created || timer.elapsed() < ItemCreationBudget))
     {
-        qDebug() << "Failed to open" << file.fileName() << "with the following error:" << file.errorString();
-        return QStringList();
+        if(cache->isLoading(m_loadQueue.at(i).second))
+        {
+            ++i;
+            continue;
+        }
+
+        QPair<Graphic*, QString> pending = m_loadQueue.takeAt(i);
+        QSharedPointer<const TemplateSchema> schema;
+        QSharedPointer<QQmlComponent> component = cache->component(pending.second, &schema);
+        pending.first->setSchema(schema);
+        pending.first->setComponent(component);
+
+        ++m_loadedCount;
+        created = true;
     }
 
-    QRegExp regexp("\\b(qcg[A-Za-z0-9]*)\\b");
-    QTextStream stream(&file);
-    QStringList list;
+    reportLoadProgress(m_loadQueue.isEmpty());
 
-    while(!stream.atEnd())
+    if(m_loadQueue.isEmpty())
     {
-        QString line = stream.readLine();
-        int pos = 0;
+        m_loadedCount = 0;
+        m_loadTotal = 0;
+    }
 
-        while((pos = regexp.indexIn(line, pos)) != -1)
-        {
-            if(!list.contains(regexp.cap(1)))
-            {
-                list << regexp.cap(1);
-            }
+    return created;
+}
 
-            pos += regexp.matchedLength();
-        }
+void Show::reportLoadProgress(bool force)
+{
+    // Several times a second is enough for a progress bar
+    if(force || m_progressTimer.elapsed() >= 100)
+    {
+        m_progressTimer.restart();
+        emit loadProgress(m_loadedCount, m_loadTotal);
     }
-
-    return list;
 }
 
 void Show::save()
@@ -247,13 +741,13 @@ void Show::save()
     {
         QDomElement graphicElement = doc.createElement("Graphic");
         graphicElement.setAttribute("name", graphic->name());
-        QFileInfo info (graphic->component()->url().path());
-        graphicElement.setAttribute("template", info.fileName());
+        graphicElement.setAttribute("template", graphic->templateName());
         graphicElement.setAttribute("onairtimerenabled", graphic->onAirTimerEnabled() ? "true" : "false");
         graphicElement.setAttribute("onairtimerinterval", graphic->onAirTimerInterval());
         graphicElement.setAttribute("group", graphic->group());
 
-        QList<QPair<QString, QVariant> > list = graphic->properties();
+        // Staged changes are saved but left for the frame loop to apply
+        QList<QPair<QString, QVariant> > list = graphic->stagedProperties();
 
         for(int i = 0; i < list.count(); ++i)
         {
@@ -266,6 +760,18 @@ void Show::save()
         rootElement.appendChild(graphicElement);
     }
 
+    foreach(const FeedBinding &binding, m_feedBindings)
+    {
+        QDomElement bindingElement = doc.createElement("FeedBinding");
+        bindingElement.setAttribute("feed", binding.feed);
+        bindingElement.setAttribute("field", binding.field);
+        bindingElement.setAttribute("graphic", binding.graphic);
+        bindingElement.setAttribute("property", QString(binding.property));
+        rootElement.appendChild(bindingElement);
+    }
+
+    rootElement.appendChild(m_rundown->save(&doc));
+
     file.write(doc.toString(4).toUtf8());
 }
 
@@ -276,6 +782,32 @@ void Show::removeGraphic(const QString &name)
     if(graphic)
     {
         m_graphicHash.remove(name);
+        m_pendingGraphics.remove(graphic);
+        m_cachedGraphics.remove(graphic);
+        m_invalidatedGraphics.remove(graphic);
+        m_materializedGraphics.removeOne(graphic);
+        graphic->setGroup(QString());
+        m_cueingGraphics.remove(graphic);
+        m_preparedGraphics.remove(graphic);
+        m_renderedGraphics.remove(graphic);
+
+        for(int i = 0; i < m_loadQueue.count(); ++i)
+        {
+            if(m_loadQueue.at(i).first == graphic)
+            {
+                m_loadQueue.removeAt(i);
+                --m_loadTotal;
+                break;
+            }
+        }
+
+        if(m_loadQueue.isEmpty())
+        {
+            m_loadedCount = 0;
+            m_loadTotal = 0;
+        }
+
+        m_mainWindow->thumbnailRenderer()->remove(m_channel->id(), name);
         delete graphic;
     }
 }
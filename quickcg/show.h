@@ -21,16 +21,42 @@
 #include <QObject>
 #include <QHash>
 #include <QStringList>
+#include <QSet>
+#include <QPair>
+#include <QElapsedTimer>
 
 class QUrl;
 class QDomElement;
 class MainWindow;
+class Channel;
+class RenderStats;
+class Rundown;
 
 class Show : public QObject
 {
     Q_OBJECT
 public:
-    explicit Show(MainWindow* mainWindow);
+    // Changes to one graphic as part of a transaction
+    struct GraphicUpdate
+    {
+        GraphicUpdate() : changeState(false), onAir(false) {}
+
+        QString graphic;
+        QList<QPair<QByteArray, QVariant> > properties;
+        bool changeState;
+        bool onAir;
+    };
+
+    // Copies a data feed field into a graphic property
+    struct FeedBinding
+    {
+        QString feed;
+        QString field;
+        QString graphic;
+        QByteArray property;
+    };
+
+    explicit Show(Channel *channel);
     ~Show();
 
     void load(const QString &path);
@@ -47,21 +73,102 @@ public:
     QString showName() const;
     QString showPath() const { return m_showPath; }
 
+    Rundown* rundown() const { return m_rundown; }
+
+    void setFeedBindings(const QList<FeedBinding> &bindings);
+    QList<FeedBinding> feedBindings() const { return m_feedBindings; }
+
+    // Stages all updates for the next frame, or none if a graphic is missing
+    bool commitTransaction(const QList<GraphicUpdate> &updates, QStringList *missing = 0);
+
+    bool applyPendingChanges(RenderStats *stats = 0);
+    bool processFrame(RenderStats *stats);
+
+    // Compiled templates are handed to graphics from the frame loop, this long at most per frame
+    static const int ItemCreationBudget = 4; // ms
+
+    bool isLoading() const { return !m_loadQueue.isEmpty(); }
+    int loadedGraphicCount() const { return m_loadedCount; }
+    int loadingGraphicCount() const { return m_loadTotal; }
+
+    // Graphics with an item, least recently used first
+    int materializedGraphicCount() const { return m_materializedGraphics.count(); }
+    qint64 itemMemoryEstimate() const;
+
+    quint64 cacheHits() const { return m_cacheHits; }
+    quint64 cacheMisses() const { return m_cacheMisses; }
+    int cachedGraphicCount() const { return m_cachedGraphics.count(); }
+
 public slots:
     void setGraphicOnAir(const QString &name, bool state);
+    QStringList clearGroup(const QString &group);
+    QStringList clearAll();
+    void cueGraphic(const QString &name);
+    void reloadTemplate(const QString &path);
+
+protected slots:
+    void addPendingGraphic(Graphic *graphic);
+    void updateGraphicCache(Graphic *graphic, bool valid);
+    void requestThumbnail(Graphic *graphic);
+    void addMaterializedGraphic(Graphic *graphic);
+    void onGraphicPrepared(Graphic *graphic, bool ready);
+    void updateGroupIndex(Graphic *graphic, const QString &previous);
+    void updateTemplateSchema(Graphic *graphic);
 
 protected:
     void loadGraphic(const QDomElement &element);
-    QStringList parseGraphicProperties(const QString &name);
+    void loadFeedBinding(const QDomElement &element);
+    void applyFeedBindings();
+    bool createPendingItems();
+    void reportLoadProgress(bool force);
+
+    void touchGraphic(Graphic *graphic);
+    bool evictIdleItems();
+    bool reportCuedGraphics();
 
 private:
     QHash<QString, Graphic*> m_graphicHash;
+    QSet<Graphic*> m_pendingGraphics;
+
+    QList<QPair<Graphic*, QString> > m_loadQueue;
+    int m_loadedCount;
+    int m_loadTotal;
+    QElapsedTimer m_progressTimer;
+
+    QList<Graphic*> m_materializedGraphics;
+    bool m_evictionPending;
+
+    QHash<QString, QSet<Graphic*> > m_groupMembers;
+    // The member last taken to air, the others were taken off then
+    QHash<QString, Graphic*> m_groupOnAir;
+
+    QSet<Graphic*> m_cueingGraphics;
+    QSet<Graphic*> m_preparedGraphics;
+    QSet<Graphic*> m_renderedGraphics;
+
+    QSet<Graphic*> m_cachedGraphics;
+    // Cached layers invalidated since the last frame, they don't count as hits
+    QSet<Graphic*> m_invalidatedGraphics;
+    quint64 m_cacheHits;
+    quint64 m_cacheMisses;
     QString m_showPath;
 
+    Rundown *m_rundown;
+
+    QList<FeedBinding> m_feedBindings;
+    // Serial of each feed when its fields were last copied
+    QHash<QString, quint64> m_feedSerials;
+
+    Channel *m_channel;
     MainWindow *m_mainWindow;
 
 signals:
-    void graphicStateChanged(const QString &graphic, bool state);
+    void graphicStateChanged(const QString &graphic, int state);
+    // ready is false if the graphic failed to load
+    void graphicCued(const QString &graphic, bool ready);
+    void graphicsCleared(const QString &group, const QStringList &graphics);
+    void rundownStatusChanged();
+    void loadProgress(int loaded, int total);
 };
 
 #endif //SHOW_H
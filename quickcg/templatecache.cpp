@@ -0,0 +1,657 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "templatecache.h"
+
+#include <QQmlEngine>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QRegExp>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+// QtQuick 1 templates are mostly source compatible with QtQuick 2, so
+// they are loaded with their import rewritten instead of being rejected.
+static QByteArray upgradeTemplate(const QByteArray &data, bool *upgraded)
+{
+    QRegExp importRegExp("^\\s*import\\s+(QtQuick\\s+1\\.\\d+|Qt\\s+4\\.7)\\b");
+    QList<QByteArray> lines = data.split('\n');
+    *upgraded = false;
+
+    for(int i = 0; i < lines.count(); ++i)
+    {
+        if(importRegExp.indexIn(QString::fromUtf8(lines[i])) != -1)
+        {
+            lines[i] = "import QtQuick 2.0";
+            *upgraded = true;
+        }
+    }
+
+    return lines.join('\n');
+}
+
+static const quint32 CacheFileMagic = 0x51434754; // "QCGT"
+static const quint32 CacheFileVersion = 1;
+
+// Prefetched templates no graphic took by then are released, e.g. when the
+// graphic was removed or switched to another template in the meantime
+static const int PrefetchTimeout = 30000; // ms
+
+static QByteArray contentHash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+struct TemplateSource
+{
+    QString path;
+    QDateTime modified;
+    QByteArray hash;
+    QByteArray data;
+    bool upgraded;
+    bool reload;
+    QString error;
+};
+
+// Runs on a worker thread
+static TemplateSource readTemplate(const QString &path, bool reload)
+{
+    TemplateSource source;
+    source.path = path;
+    source.modified = QFileInfo(path).lastModified();
+    source.upgraded = false;
+    source.reload = reload;
+
+    QFile file(path);
+
+    if(file.open(QIODevice::ReadOnly))
+    {
+        QByteArray data = file.readAll();
+        source.hash = contentHash(data);
+        source.data = upgradeTemplate(data, &source.upgraded);
+    }
+    else
+    {
+        source.error = file.errorString();
+    }
+
+    return source;
+}
+
+TemplateCache::TemplateCache(QQmlEngine *engine, QObject *parent) :
+    QObject(parent), m_engine(engine), m_revision(0), m_hits(0), m_misses(0)
+{
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, SIGNAL(fileChanged(QString)),
+            this, SLOT(onFileChanged(QString)));
+    connect(m_watcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(onDirectoryChanged(QString)));
+
+    // Editors tend to write a file in several steps, wait for them to finish
+    m_reloadTimer = new QTimer(this);
+    m_reloadTimer->setInterval(250);
+    m_reloadTimer->setSingleShot(true);
+    connect(m_reloadTimer, SIGNAL(timeout()),
+            this, SLOT(reloadChangedFiles()));
+
+    // New schemas usually come in bunches while a show loads
+    m_saveTimer = new QTimer(this);
+    m_saveTimer->setInterval(1000);
+    m_saveTimer->setSingleShot(true);
+    connect(m_saveTimer, SIGNAL(timeout()),
+            this, SLOT(saveCacheFile()));
+
+    m_prefetchTimer = new QTimer(this);
+    m_prefetchTimer->setInterval(PrefetchTimeout);
+    m_prefetchTimer->setSingleShot(true);
+    connect(m_prefetchTimer, SIGNAL(timeout()),
+            this, SLOT(expirePrefetched()));
+}
+
+TemplateCache::~TemplateCache()
+{
+    if(m_saveTimer->isActive())
+    {
+        saveCacheFile();
+    }
+}
+
+void TemplateCache::setCacheFile(const QString &path)
+{
+    m_cacheFile = path;
+    loadCacheFile();
+}
+
+void TemplateCache::loadCacheFile()
+{
+    QFile file(m_cacheFile);
+
+    if(!file.exists())
+    {
+        return;
+    }
+
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Failed to open" << m_cacheFile << "with the following error:" << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString qtVersion;
+    stream >> magic >> version >> qtVersion;
+
+    // Property indices may differ with another Qt version
+    if(magic != CacheFileMagic || version != CacheFileVersion || qtVersion != QString(qVersion()))
+    {
+        return;
+    }
+
+    quint32 count = 0;
+    stream >> count;
+
+    for(quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        QByteArray hash;
+        stream >> hash;
+        TemplateSchema *schema = TemplateSchema::read(stream);
+
+        if(!schema)
+        {
+            break;
+        }
+
+        m_schemas.insert(hash, QSharedPointer<const TemplateSchema>(schema));
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        qDebug() << "The template cache" << m_cacheFile << "is corrupt, ignoring the rest of it";
+    }
+}
+
+void TemplateCache::saveCacheFile()
+{
+    m_saveTimer->stop();
+
+    if(m_cacheFile.isEmpty())
+    {
+        return;
+    }
+
+    // Written to a temporary file and renamed, a crash never leaves half a cache
+    QSaveFile file(m_cacheFile);
+
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Failed to open" << m_cacheFile << "for writing with the following error:" << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << CacheFileMagic << CacheFileVersion << QString(qVersion()) << quint32(m_schemas.count());
+
+    for(QHash<QByteArray, QSharedPointer<const TemplateSchema> >::const_iterator it = m_schemas.constBegin();
+        it != m_schemas.constEnd(); ++it)
+    {
+        stream << it.key();
+        it.value()->write(stream);
+    }
+
+    if(!file.commit())
+    {
+        qDebug() << "Failed to write" << m_cacheFile << "with the following error:" << file.errorString();
+    }
+}
+
+QSharedPointer<QQmlComponent> TemplateCache::component(const QString &path, QSharedPointer<const TemplateSchema> *schema)
+{
+    QFileInfo info(path);
+    QString key = info.canonicalFilePath();
+
+    if(key.isEmpty())
+    {
+        qDebug() << "Failed to open" << path << ", the template does not exist";
+        return QSharedPointer<QQmlComponent>();
+    }
+
+    QDateTime modified = info.lastModified();
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+    bool fresh = false;
+
+    if(it != m_entries.constEnd())
+    {
+        if(it->modified == modified)
+        {
+            QSharedPointer<QQmlComponent> component = it->component.toStrongRef();
+
+            if(component)
+            {
+                ++m_hits;
+                m_prefetched.remove(key);
+
+                if(schema)
+                {
+                    *schema = entrySchema(key, component.data());
+                }
+
+                return component;
+            }
+        }
+
+        fresh = it->reloaded || it->modified != modified;
+    }
+
+    if(m_failed.contains(key) && m_failed.value(key) == modified)
+    {
+        return QSharedPointer<QQmlComponent>();
+    }
+
+    ++m_misses;
+
+    QFile file(key);
+
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Failed to open" << key << "with the following error:" << file.errorString();
+        return QSharedPointer<QQmlComponent>();
+    }
+
+    bool upgraded = false;
+    QByteArray data = file.readAll();
+    QByteArray hash = contentHash(data);
+    data = upgradeTemplate(data, &upgraded);
+    QSharedPointer<QQmlComponent> component(compile(key, data, upgraded, fresh, QQmlComponent::PreferSynchronous));
+
+    if(component->isError())
+    {
+        qDebug() << "Failed to load component:" << component->errors();
+        m_failed.insert(key, modified);
+        return QSharedPointer<QQmlComponent>();
+    }
+
+    // Only happens while the same file is being prefetched, callers should check isLoading() first
+    if(component->isLoading())
+    {
+        return component;
+    }
+
+    storeComponent(key, modified, hash, fresh, component);
+
+    if(schema)
+    {
+        *schema = entrySchema(key, component.data());
+    }
+
+    return component;
+}
+
+void TemplateCache::prefetch(const QString &path)
+{
+    QFileInfo info(path);
+    QString key = info.canonicalFilePath();
+
+    if(key.isEmpty() || m_loadingPaths.contains(key))
+    {
+        return;
+    }
+
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+
+    if(it != m_entries.constEnd() && it->modified == info.lastModified() && !it->component.isNull())
+    {
+        return;
+    }
+
+    if(m_failed.contains(key) && m_failed.value(key) == info.lastModified())
+    {
+        return;
+    }
+
+    startLoad(key, false);
+}
+
+void TemplateCache::startLoad(const QString &path, bool reload)
+{
+    ++m_loadingPaths[path];
+
+    QFutureWatcher<TemplateSource> *watcher = new QFutureWatcher<TemplateSource>(this);
+    connect(watcher, SIGNAL(finished()),
+            this, SLOT(onTemplateRead()));
+    watcher->setFuture(QtConcurrent::run(readTemplate, path, reload));
+}
+
+void TemplateCache::onTemplateRead()
+{
+    QFutureWatcher<TemplateSource> *watcher = static_cast<QFutureWatcher<TemplateSource>*>(sender());
+    TemplateSource source = watcher->result();
+    watcher->deleteLater();
+
+    if(!source.error.isEmpty())
+    {
+        qDebug() << "Failed to open" << source.path << "with the following error:" << source.error;
+
+        if(--m_loadingPaths[source.path] <= 0)
+        {
+            m_loadingPaths.remove(source.path);
+        }
+
+        return;
+    }
+
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(source.path);
+
+    Load load;
+    load.path = source.path;
+    load.modified = source.modified;
+    load.hash = source.hash;
+    load.fresh = it != m_entries.constEnd() && (it->reloaded || it->modified != source.modified);
+    load.reload = source.reload;
+
+    ++m_misses;
+
+    QQmlComponent *component = compile(source.path, source.data, source.upgraded, load.fresh, QQmlComponent::Asynchronous);
+    m_loads.insert(component, load);
+
+    if(component->isLoading())
+    {
+        connect(component, SIGNAL(statusChanged(QQmlComponent::Status)),
+                this, SLOT(onLoadStatusChanged()));
+    }
+    else
+    {
+        finishLoad(component);
+    }
+}
+
+QQmlComponent* TemplateCache::compile(const QString &path, const QByteArray &data, bool upgraded, bool fresh,
+                                      QQmlComponent::CompilationMode mode)
+{
+    QQmlComponent *component = new QQmlComponent(m_engine);
+    QUrl url = QUrl::fromLocalFile(path);
+
+    if(upgraded)
+    {
+        // Rewritten templates can only be compiled from data, which is synchronous
+        component->setData(data, url);
+    }
+    else
+    {
+        // The engine caches compiled types by URL, a new query makes it
+        // compile the current contents of a modified file
+        if(fresh)
+        {
+            QUrlQuery query;
+            query.addQueryItem("revision", QString::number(++m_revision));
+            url.setQuery(query);
+        }
+
+        component->loadUrl(url, mode);
+    }
+
+    return component;
+}
+
+void TemplateCache::onLoadStatusChanged()
+{
+    QQmlComponent *component = qobject_cast<QQmlComponent*>(sender());
+
+    if(component && !component->isLoading())
+    {
+        finishLoad(component);
+    }
+}
+
+void TemplateCache::finishLoad(QQmlComponent *component)
+{
+    if(!m_loads.contains(component))
+    {
+        return;
+    }
+
+    Load load = m_loads.take(component);
+    disconnect(component, 0, this, 0);
+
+    if(--m_loadingPaths[load.path] <= 0)
+    {
+        m_loadingPaths.remove(load.path);
+    }
+
+    // Graphics keep the previous version when a reload has errors
+    if(component->isError())
+    {
+        qDebug() << "Failed to load template" << load.path << ":" << component->errors();
+        m_failed.insert(load.path, load.modified);
+        component->deleteLater();
+        return;
+    }
+
+    // A load that finished after a newer one
+    if(m_entries.value(load.path).modified > load.modified)
+    {
+        component->deleteLater();
+        return;
+    }
+
+    QSharedPointer<QQmlComponent> shared(component);
+    storeComponent(load.path, load.modified, load.hash, load.fresh, shared);
+
+    if(load.reload)
+    {
+        // A prefetched previous version is not needed anymore
+        m_prefetched.remove(load.path);
+
+        // Graphics pick up the component from the cache while shared holds it
+        emit templateReloaded(load.path);
+    }
+    else
+    {
+        // Held until the first graphic takes it, or the timeout
+        Prefetched prefetched;
+        prefetched.component = shared;
+        prefetched.age.start();
+        m_prefetched.insert(load.path, prefetched);
+
+        if(!m_prefetchTimer->isActive())
+        {
+            m_prefetchTimer->start();
+        }
+    }
+}
+
+void TemplateCache::expirePrefetched()
+{
+    QHash<QString, Prefetched>::iterator it = m_prefetched.begin();
+    qint64 oldest = 0;
+
+    while(it != m_prefetched.end())
+    {
+        if(it->age.elapsed() >= PrefetchTimeout)
+        {
+            it = m_prefetched.erase(it);
+        }
+        else
+        {
+            oldest = qMax(oldest, it->age.elapsed());
+            ++it;
+        }
+    }
+
+    if(!m_prefetched.isEmpty())
+    {
+        m_prefetchTimer->start(int(PrefetchTimeout - oldest));
+    }
+}
+
+QSharedPointer<const TemplateSchema> TemplateCache::entrySchema(const QString &path, QQmlComponent *component)
+{
+    QHash<QString, Entry>::iterator it = m_entries.find(path);
+
+    if(it == m_entries.end())
+    {
+        return QSharedPointer<const TemplateSchema>();
+    }
+
+    if(!it->schema)
+    {
+        // Needs a throwaway instance, so only done when a graphic takes the template
+        it->schema = QSharedPointer<const TemplateSchema>(TemplateSchema::build(component));
+        m_schemas.insert(it->hash, it->schema);
+        m_saveTimer->start();
+    }
+
+    return it->schema;
+}
+
+void TemplateCache::updateSchema(const QString &path, QQmlComponent *component, const QSharedPointer<const TemplateSchema> &schema)
+{
+    QHash<QString, Entry>::iterator it = m_entries.find(path);
+
+    // The file may have been reloaded since the graphic got its component
+    if(it == m_entries.end() || it->component.data() != component)
+    {
+        return;
+    }
+
+    it->schema = schema;
+    m_schemas.insert(it->hash, schema);
+    m_saveTimer->start();
+}
+
+void TemplateCache::storeComponent(const QString &path, const QDateTime &modified, const QByteArray &hash, bool fresh,
+                                   const QSharedPointer<QQmlComponent> &component)
+{
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(path);
+    QByteArray oldHash = it != m_entries.constEnd() ? it->hash : QByteArray();
+
+    m_failed.remove(path);
+
+    Entry entry;
+    entry.modified = modified;
+    entry.hash = hash;
+    entry.reloaded = fresh || (it != m_entries.constEnd() && it->reloaded);
+    entry.component = component;
+
+    // Unchanged contents keep their schema even if the component was freed,
+    // others get one from entrySchema()
+    entry.schema = m_schemas.value(hash);
+
+    m_entries.insert(path, entry);
+
+    // The previous version of an edited template won't be needed again
+    if(!oldHash.isEmpty() && oldHash != hash)
+    {
+        bool used = false;
+
+        foreach(const Entry &other, m_entries)
+        {
+            used |= other.hash == oldHash;
+        }
+
+        if(!used)
+        {
+            m_schemas.remove(oldHash);
+            m_saveTimer->start();
+        }
+    }
+
+    if(!m_watcher->files().contains(path))
+    {
+        m_watcher->addPath(path);
+    }
+
+    // A file saved by a rename drops out of the watcher, the directory
+    // tells when it is back
+    QString dir = QFileInfo(path).absolutePath();
+
+    if(!m_watcher->directories().contains(dir))
+    {
+        m_watcher->addPath(dir);
+    }
+}
+
+int TemplateCache::templateCount() const
+{
+    int count = 0;
+
+    foreach(const Entry &entry, m_entries)
+    {
+        if(!entry.component.isNull())
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+void TemplateCache::onFileChanged(const QString &path)
+{
+    m_changedPaths.insert(path);
+    m_reloadTimer->start();
+}
+
+void TemplateCache::onDirectoryChanged(const QString &path)
+{
+    QStringList files = m_watcher->files();
+
+    foreach(const QString &key, m_entries.keys())
+    {
+        if(!files.contains(key) && QFileInfo(key).absolutePath() == path)
+        {
+            onFileChanged(key);
+        }
+    }
+}
+
+void TemplateCache::reloadChangedFiles()
+{
+    QSet<QString> paths;
+    paths.swap(m_changedPaths);
+
+    foreach(const QString &path, paths)
+    {
+        // Still being replaced, onDirectoryChanged() brings it back once the new file is there
+        if(!QFileInfo(path).exists())
+        {
+            continue;
+        }
+
+        if(!m_watcher->files().contains(path))
+        {
+            m_watcher->addPath(path);
+        }
+
+        QHash<QString, Entry>::const_iterator it = m_entries.constFind(path);
+
+        if(it != m_entries.constEnd() && it->modified != QFileInfo(path).lastModified())
+        {
+            startLoad(path, true);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEMPLATECACHE_H
+#define TEMPLATECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QString>
+#include <QQmlComponent>
+
+#include "templateschema.h"
+
+class QQmlEngine;
+class QFileSystemWatcher;
+class QTimer;
+
+// Compiled templates shared between the graphics that use them. Entries
+// are keyed by canonical path and only weakly referenced, so a component
+// lives as long as a graphic uses it and a template is compiled again
+// when the file was modified in between. The property schema of each
+// template is kept with it and rebuilt when the file changes.
+//
+// prefetch() reads a template on a worker thread and compiles it on the
+// engine's loader thread, component() returns it without blocking once
+// isLoading() is false. Compiled templates are watched, and a modified
+// one is compiled again the same way and announced through
+// templateReloaded(). Graphics keep using the old component until they
+// are switched.
+//
+// Schemas are keyed by a hash of the template contents and stored in the
+// cache file, so an unchanged template does not need a throwaway instance
+// after a restart. A missing schema is built by component(), which the
+// show calls within its per-frame creation budget. Compiled code is left
+// to the engine's own disk cache.
+class TemplateCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TemplateCache(QQmlEngine *engine, QObject *parent = 0);
+    ~TemplateCache();
+
+    void setCacheFile(const QString &path);
+
+    QSharedPointer<QQmlComponent> component(const QString &path, QSharedPointer<const TemplateSchema> *schema = 0);
+
+    void prefetch(const QString &path);
+    bool isLoading(const QString &path) const { return m_loadingPaths.contains(path); }
+
+    // The schema of a template compiled before, without touching the file
+    QSharedPointer<const TemplateSchema> schema(const QString &path) const { return m_entries.value(path).schema; }
+    // Replaces a schema a graphic found out of date with the one it rebuilt
+    void updateSchema(const QString &path, QQmlComponent *component, const QSharedPointer<const TemplateSchema> &schema);
+
+    quint64 hits() const { return m_hits; }
+    quint64 misses() const { return m_misses; }
+    int templateCount() const;
+
+protected slots:
+    void onFileChanged(const QString &path);
+    void onDirectoryChanged(const QString &path);
+    void reloadChangedFiles();
+
+    void onTemplateRead();
+    void onLoadStatusChanged();
+
+    void saveCacheFile();
+    void expirePrefetched();
+
+protected:
+    void startLoad(const QString &path, bool reload);
+    QQmlComponent* compile(const QString &path, const QByteArray &data, bool upgraded, bool fresh,
+                           QQmlComponent::CompilationMode mode);
+    void finishLoad(QQmlComponent *component);
+    void storeComponent(const QString &path, const QDateTime &modified, const QByteArray &hash, bool fresh,
+                        const QSharedPointer<QQmlComponent> &component);
+    void loadCacheFile();
+    QSharedPointer<const TemplateSchema> entrySchema(const QString &path, QQmlComponent *component);
+
+private:
+    struct Entry
+    {
+        QDateTime modified;
+        QByteArray hash;
+        bool reloaded;
+        QWeakPointer<QQmlComponent> component;
+        QSharedPointer<const TemplateSchema> schema;
+    };
+
+    struct Prefetched
+    {
+        QSharedPointer<QQmlComponent> component;
+        QElapsedTimer age;
+    };
+
+    struct Load
+    {
+        QString path;
+        QDateTime modified;
+        QByteArray hash;
+        bool fresh;
+        bool reload;
+    };
+
+    QQmlEngine *m_engine;
+    QHash<QString, Entry> m_entries;
+
+    QHash<QQmlComponent*, Load> m_loads;
+    QHash<QString, int> m_loadingPaths;
+    QHash<QString, Prefetched> m_prefetched;
+    // Modification time of templates that failed to compile, tried again once the file changes
+    QHash<QString, QDateTime> m_failed;
+    QTimer *m_prefetchTimer;
+    int m_revision;
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_reloadTimer;
+    QSet<QString> m_changedPaths;
+
+    QString m_cacheFile;
+    QHash<QByteArray, QSharedPointer<const TemplateSchema> > m_schemas;
+    QTimer *m_saveTimer;
+
+    quint64 m_hits;
+    quint64 m_misses;
+
+signals:
+    void templateReloaded(const QString &path);
+};
+
+#endif // TEMPLATECACHE_H
@@ -0,0 +1,252 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "templateschema.h"
+
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QMetaProperty>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QScopedPointer>
+#include <QDebug>
+
+TemplateSchema* TemplateSchema::build(QQmlComponent *component)
+{
+    if(!component || !component->isReady())
+    {
+        return new TemplateSchema;
+    }
+
+    QObject *object = component->create();
+
+    if(!object)
+    {
+        qDebug() << "Failed to read the properties of" << component->url() << ":" << component->errors();
+        return new TemplateSchema;
+    }
+
+    TemplateSchema *schema = fromObject(object);
+    delete object;
+
+    return schema;
+}
+
+TemplateSchema* TemplateSchema::fromObject(QObject *object)
+{
+    TemplateSchema *schema = new TemplateSchema;
+    const QMetaObject *metaObject = object->metaObject();
+
+    for(int i = 0; i < metaObject->propertyCount(); ++i)
+    {
+        QMetaProperty metaProperty = metaObject->property(i);
+        QByteArray name = metaProperty.name();
+
+        if(!name.startsWith("qcg"))
+        {
+            continue;
+        }
+
+        Property property;
+        property.name = name;
+        property.typeName = metaProperty.typeName();
+        property.type = metaProperty.userType();
+        property.index = i;
+        property.defaultValue = metaProperty.read(object);
+
+        schema->m_indexHash.insert(name, i);
+        schema->m_properties.append(property);
+    }
+
+    return schema;
+}
+
+bool TemplateSchema::matches(const QMetaObject *metaObject) const
+{
+    foreach(const Property &property, m_properties)
+    {
+        if(property.index >= metaObject->propertyCount() || property.name != metaObject->property(property.index).name())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Values like object references can't be written to a stream
+static bool isStreamable(const QVariant &value)
+{
+    int type = value.userType();
+
+    return value.isValid() && type < QMetaType::User && type != QMetaType::QObjectStar && type != QMetaType::VoidStar;
+}
+
+void TemplateSchema::write(QDataStream &stream) const
+{
+    stream << quint32(m_properties.count());
+
+    foreach(const Property &property, m_properties)
+    {
+        stream << property.name << property.typeName << qint32(property.type) << qint32(property.index)
+               << (isStreamable(property.defaultValue) ? property.defaultValue : QVariant());
+    }
+}
+
+TemplateSchema* TemplateSchema::read(QDataStream &stream)
+{
+    TemplateSchema *schema = new TemplateSchema;
+    quint32 count = 0;
+    stream >> count;
+
+    for(quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        Property property;
+        qint32 type = 0;
+        qint32 index = 0;
+        stream >> property.name >> property.typeName >> type >> index >> property.defaultValue;
+        property.type = type;
+        property.index = index;
+
+        schema->m_indexHash.insert(property.name, property.index);
+        schema->m_properties.append(property);
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        delete schema;
+        return 0;
+    }
+
+    return schema;
+}
+
+int TemplateSchema::benchmark(int iterations)
+{
+    QTextStream out(stdout);
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData("import QtQuick 2.0\n"
+                      "Item {\n"
+                      "    property string qcgTitle: \"\"\n"
+                      "    property string qcgSubtitle: \"\"\n"
+                      "    property real qcgValue: 0\n"
+                      "    property int qcgCount: 0\n"
+                      "    property color qcgColor: \"white\"\n"
+                      "    property bool qcgVisible: true\n"
+                      "    width: 1920; height: 1080\n"
+                      "}\n", QUrl());
+
+    QScopedPointer<TemplateSchema> schema(build(&component));
+    QScopedPointer<QObject> object(component.create());
+
+    if(!object || schema->count() == 0)
+    {
+        out << "Failed to create the benchmark template: " << component.errorString() << "\n";
+        return 1;
+    }
+
+    // Names as they arrive over the protocol, without the prefix
+    QList<QByteArray> names;
+    names << "Title" << "Subtitle" << "Value" << "Count" << "Color" << "Visible";
+
+    QList<QVariant> values;
+    values << QString("Breaking news") << QString("Live") << 0.5 << 42 << QString("#ff8000") << false;
+
+    const QMetaObject *metaObject = object->metaObject();
+    int operations = iterations * names.count();
+    int result = 0;
+
+    out << "Property access, " << names.count() << " properties, " << iterations << " iterations\n";
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for(int i = 0; i < names.count(); ++i)
+        {
+            QByteArray name = names.at(i);
+            name.prepend("qcg");
+            object->setProperty(name, values.at(i));
+        }
+    }
+
+    double byName = double(timer.nsecsElapsed()) / operations;
+    timer.restart();
+
+    for(int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for(int i = 0; i < names.count(); ++i)
+        {
+            QByteArray name = names.at(i);
+            name.prepend("qcg");
+            metaObject->property(schema->propertyIndex(name)).write(object.data(), values.at(i));
+        }
+    }
+
+    double byIndex = double(timer.nsecsElapsed()) / operations;
+
+    out << "  write by name:  " << QString::number(byName, 'f', 1) << " ns\n";
+    out << "  write by index: " << QString::number(byIndex, 'f', 1) << " ns\n";
+
+    QList<QByteArray> prefixedNames;
+
+    foreach(const Property &property, schema->properties())
+    {
+        prefixedNames.append(property.name);
+    }
+
+    QVariantList namedValues;
+    QVariantList indexedValues;
+    timer.restart();
+
+    for(int iteration = 0; iteration < iterations; ++iteration)
+    {
+        namedValues.clear();
+
+        foreach(const QByteArray &name, prefixedNames)
+        {
+            namedValues.append(object->property(name));
+        }
+    }
+
+    byName = double(timer.nsecsElapsed()) / operations;
+    timer.restart();
+
+    for(int iteration = 0; iteration < iterations; ++iteration)
+    {
+        indexedValues.clear();
+
+        foreach(const Property &property, schema->m_properties)
+        {
+            indexedValues.append(metaObject->property(property.index).read(object.data()));
+        }
+    }
+
+    byIndex = double(timer.nsecsElapsed()) / operations;
+
+    out << "  read by name:   " << QString::number(byName, 'f', 1) << " ns\n";
+    out << "  read by index:  " << QString::number(byIndex, 'f', 1) << " ns\n";
+
+    if(namedValues != indexedValues)
+    {
+        out << "  (values read by index differ)\n";
+        result = 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,70 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEMPLATESCHEMA_H
+#define TEMPLATESCHEMA_H
+
+#include <QByteArray>
+#include <QVariant>
+#include <QList>
+#include <QHash>
+
+class QQmlComponent;
+class QDataStream;
+class QObject;
+struct QMetaObject;
+
+// The qcg properties a template declares, read once from the meta-object
+// of a throwaway instance. Property indices are the same for every
+// instance created from the component.
+class TemplateSchema
+{
+public:
+    struct Property
+    {
+        QByteArray name;
+        QByteArray typeName;
+        int type;
+        int index;
+        QVariant defaultValue;
+    };
+
+    static TemplateSchema* build(QQmlComponent *component);
+    // An instance that hasn't been written to yet, its values are the defaults
+    static TemplateSchema* fromObject(QObject *object);
+
+    // False if a property moved, e.g. a stored schema after an imported type changed
+    bool matches(const QMetaObject *metaObject) const;
+
+    // Indices depend on the Qt version, stored schemas are only valid for the one that wrote them
+    void write(QDataStream &stream) const;
+    static TemplateSchema* read(QDataStream &stream);
+
+    // Compares property access by name with access through the schema indices, needs a GUI application
+    static int benchmark(int iterations);
+
+    QList<Property> properties() const { return m_properties; }
+    int count() const { return m_properties.count(); }
+
+    bool contains(const QByteArray &name) const { return m_indexHash.contains(name); }
+    // Meta-object property index, -1 if the template has no such property
+    int propertyIndex(const QByteArray &name) const { return m_indexHash.value(name, -1); }
+
+private:
+    QList<Property> m_properties;
+    QHash<QByteArray, int> m_indexHash;
+};
+
+#endif // TEMPLATESCHEMA_H
@@ -0,0 +1,301 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "thumbnailrenderer.h"
+#include "renderer.h"
+#include "graphic.h"
+#include "downscaler.h"
+
+#include <QQuickItem>
+#include <QQmlComponent>
+#include <QQmlListReference>
+#include <QBuffer>
+#include <QImage>
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+struct EncodedThumbnail
+{
+    int channel;
+    QString graphic;
+    quint64 revision;
+    QByteArray data;
+};
+
+// Runs on a worker thread
+static EncodedThumbnail encodeThumbnail(const QImage &frame, int channel, const QString &graphic, quint64 revision)
+{
+    QImage image(ThumbnailRenderer::Width, ThumbnailRenderer::Height, QImage::Format_ARGB32_Premultiplied);
+    Downscaler::scale(frame, &image);
+
+    EncodedThumbnail thumbnail;
+    thumbnail.channel = channel;
+    thumbnail.graphic = graphic;
+    thumbnail.revision = revision;
+
+    QBuffer buffer(&thumbnail.data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+
+    return thumbnail;
+}
+
+ThumbnailRenderer::ThumbnailRenderer(const QSize &programSize, QObject *parent) :
+    QObject(parent), m_currentChannel(-1), m_currentRevision(0), m_currentItem(0), m_frameRequested(false)
+{
+    // Rendered at twice the thumbnail size and box filtered down for smoother edges
+    m_renderer = new Renderer(this);
+    m_renderer->setOutputSize(QSize(2 * Width, 2 * Height));
+    m_renderer->setRenderThreadPriority(QThread::LowPriority);
+
+    m_container = new QQuickItem;
+    m_container->setTransformOrigin(QQuickItem::TopLeft);
+    m_container->setScale(2.0 * Width / programSize.width());
+    m_container->setParentItem(m_renderer->rootItem());
+
+    connect(m_renderer, SIGNAL(frameRendered(QImage)),
+            this, SLOT(finishThumbnail(QImage)), Qt::QueuedConnection);
+
+    m_clock.start();
+}
+
+ThumbnailRenderer::~ThumbnailRenderer()
+{
+    delete m_currentItem;
+    delete m_container;
+}
+
+QString ThumbnailRenderer::key(int channel, const QString &graphic)
+{
+    return QString("%1/%2").arg(channel).arg(graphic);
+}
+
+void ThumbnailRenderer::request(int channel, Graphic *graphic)
+{
+    if(!graphic)
+    {
+        return;
+    }
+
+    for(int i = 0; i < m_requests.count(); ++i)
+    {
+        if(m_requests[i].channel == channel && m_requests[i].graphic == graphic)
+        {
+            // Still changing, waits until it settles
+            m_requests[i].requested = m_clock.elapsed();
+            return;
+        }
+    }
+
+    Request request;
+    request.channel = channel;
+    request.graphic = graphic;
+    request.requested = m_clock.elapsed();
+    m_requests.append(request);
+}
+
+void ThumbnailRenderer::remove(int channel, const QString &graphic)
+{
+    m_thumbnails.remove(key(channel, graphic));
+    m_lastRendered.remove(key(channel, graphic));
+    m_encoding.remove(key(channel, graphic));
+
+    if(m_currentChannel == channel && m_currentGraphic == graphic)
+    {
+        m_currentGraphic.clear();
+    }
+}
+
+QByteArray ThumbnailRenderer::thumbnail(int channel, const QString &graphic, quint64 *revision) const
+{
+    Thumbnail thumbnail = m_thumbnails.value(key(channel, graphic));
+
+    if(revision)
+    {
+        *revision = thumbnail.data.isEmpty() ? 0 : thumbnail.revision;
+    }
+
+    return thumbnail.data;
+}
+
+void ThumbnailRenderer::processFrame()
+{
+    if(m_currentItem)
+    {
+        if(!m_frameRequested)
+        {
+            requestFrame();
+        }
+
+        return;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    int i = 0;
+
+    while(i < m_requests.count())
+    {
+        const Request &request = m_requests.at(i);
+
+        if(!request.graphic)
+        {
+            m_requests.removeAt(i);
+            continue;
+        }
+
+        QString requestKey = key(request.channel, request.graphic->name());
+
+        if(now - request.requested < SettleTime ||
+           (m_lastRendered.contains(requestKey) && now - m_lastRendered.value(requestKey) < MinInterval))
+        {
+            ++i;
+            continue;
+        }
+
+        Request started = m_requests.takeAt(i);
+
+        if(startThumbnail(started.channel, started.graphic))
+        {
+            m_lastRendered.insert(requestKey, now);
+            return;
+        }
+    }
+}
+
+bool ThumbnailRenderer::startThumbnail(int channel, Graphic *graphic)
+{
+    if(!graphic->component() || !graphic->component()->isReady())
+    {
+        return false;
+    }
+
+    QHash<QString, Thumbnail>::const_iterator it = m_thumbnails.constFind(key(channel, graphic->name()));
+
+    if(it != m_thumbnails.constEnd() && it->revision == graphic->revision())
+    {
+        return false;
+    }
+
+    QObject *object = graphic->component()->create();
+    QQuickItem *item = qobject_cast<QQuickItem*>(object);
+
+    if(!item)
+    {
+        qDebug() << "Failed to create thumbnail for graphic" << graphic->name();
+        delete object;
+        return false;
+    }
+
+    // Same values as the program output, which may not have an item yet
+    QList<QPair<QString, QVariant> > properties = graphic->properties();
+
+    for(int i = 0; i < properties.count(); ++i)
+    {
+        item->setProperty(properties.at(i).first.toLatin1(), properties.at(i).second);
+    }
+
+    // Without transitions the item goes straight to the end of the on air state
+    QQmlListReference transitions(item, "transitions");
+    transitions.clear();
+    item->setProperty("state", "onAir");
+    item->setParentItem(m_container);
+
+    m_currentChannel = channel;
+    m_currentGraphic = graphic->name();
+    m_currentRevision = graphic->revision();
+    m_currentItem = item;
+
+    requestFrame();
+
+    return true;
+}
+
+void ThumbnailRenderer::requestFrame()
+{
+    // Exactly one frame per thumbnail, if the render thread is still busy
+    // it is asked again on the next tick
+    m_frameRequested = !m_renderer->isBusy();
+
+    if(m_frameRequested)
+    {
+        m_renderer->invalidate();
+        m_renderer->renderFrame();
+    }
+}
+
+void ThumbnailRenderer::finishThumbnail(const QImage &frame)
+{
+    if(!m_currentItem)
+    {
+        return;
+    }
+
+    delete m_currentItem;
+    m_currentItem = 0;
+    m_frameRequested = false;
+
+    if(m_currentGraphic.isEmpty())
+    {
+        // Removed while it was being rendered
+        return;
+    }
+
+    ++m_encoding[key(m_currentChannel, m_currentGraphic)];
+
+    QFutureWatcher<EncodedThumbnail> *watcher = new QFutureWatcher<EncodedThumbnail>(this);
+    connect(watcher, SIGNAL(finished()),
+            this, SLOT(onThumbnailEncoded()));
+    watcher->setFuture(QtConcurrent::run(encodeThumbnail, frame, m_currentChannel, m_currentGraphic, m_currentRevision));
+
+    m_currentGraphic.clear();
+}
+
+void ThumbnailRenderer::onThumbnailEncoded()
+{
+    QFutureWatcher<EncodedThumbnail> *watcher = static_cast<QFutureWatcher<EncodedThumbnail>*>(sender());
+    EncodedThumbnail encoded = watcher->result();
+    watcher->deleteLater();
+
+    QString thumbnailKey = key(encoded.channel, encoded.graphic);
+
+    // Removed while it was being encoded
+    if(!m_encoding.contains(thumbnailKey))
+    {
+        return;
+    }
+
+    if(--m_encoding[thumbnailKey] <= 0)
+    {
+        m_encoding.remove(thumbnailKey);
+    }
+
+    Thumbnail &thumbnail = m_thumbnails[thumbnailKey];
+
+    // A later revision that finished first wins
+    if(!thumbnail.data.isEmpty() && thumbnail.revision > encoded.revision)
+    {
+        return;
+    }
+
+    bool changed = thumbnail.data != encoded.data;
+    thumbnail.revision = encoded.revision;
+    thumbnail.data = encoded.data;
+
+    if(changed)
+    {
+        emit thumbnailChanged(encoded.channel, encoded.graphic, encoded.revision, encoded.data);
+    }
+}
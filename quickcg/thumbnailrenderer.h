@@ -0,0 +1,106 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef THUMBNAILRENDERER_H
+#define THUMBNAILRENDERER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QList>
+#include <QSize>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+class QImage;
+class QQuickItem;
+class Renderer;
+class Graphic;
+
+// Renders small PNG previews of graphics in their on air state. It uses
+// its own renderer and instance of the template, so the program output
+// is never touched, and renders at most one thumbnail per frame tick.
+// A graphic is rendered once its properties stopped changing for a while
+// and at most once per MinInterval, so graphics driven by feeds or
+// rundowns don't cost an instance every frame. Scaling and PNG encoding
+// run on a worker thread. Thumbnails are cached by graphic and revision
+// and only reported when the image actually changed.
+class ThumbnailRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailRenderer(const QSize &programSize, QObject *parent = 0);
+    ~ThumbnailRenderer();
+
+    static const int Width = 320;
+    static const int Height = 180;
+
+    static const int SettleTime = 250; // ms
+    static const int MinInterval = 1000; // ms
+
+    void request(int channel, Graphic *graphic);
+    void remove(int channel, const QString &graphic);
+
+    QByteArray thumbnail(int channel, const QString &graphic, quint64 *revision = 0) const;
+
+public slots:
+    void processFrame();
+
+protected slots:
+    void finishThumbnail(const QImage &frame);
+    void onThumbnailEncoded();
+
+protected:
+    bool startThumbnail(int channel, Graphic *graphic);
+    void requestFrame();
+
+    static QString key(int channel, const QString &graphic);
+
+private:
+    struct Request
+    {
+        int channel;
+        QPointer<Graphic> graphic;
+        qint64 requested; // Last change, in ms on m_clock
+    };
+
+    struct Thumbnail
+    {
+        quint64 revision;
+        QByteArray data;
+    };
+
+    Renderer *m_renderer;
+    QQuickItem *m_container;
+
+    QList<Request> m_requests;
+    QHash<QString, Thumbnail> m_thumbnails;
+
+    QElapsedTimer m_clock;
+    QHash<QString, qint64> m_lastRendered;
+    // Encodes in flight by key, removing a graphic drops its entry
+    QHash<QString, int> m_encoding;
+
+    int m_currentChannel;
+    QString m_currentGraphic;
+    quint64 m_currentRevision;
+    QQuickItem *m_currentItem;
+    bool m_frameRequested;
+
+signals:
+    void thumbnailChanged(int channel, const QString &graphic, quint64 revision, const QByteArray &data);
+};
+
+#endif // THUMBNAILRENDERER_H
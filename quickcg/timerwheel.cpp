@@ -0,0 +1,289 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "timerwheel.h"
+#include "frameclock.h"
+
+#include <QDebug>
+#include <QPair>
+
+TimerWheel::TimerWheel(FrameClock *clock, QObject *parent) :
+    QObject(parent), m_clock(clock), m_currentFrame(0), m_nextId(1)
+{
+    for(int level = 0; level < LevelCount; ++level)
+    {
+        for(int i = 0; i < SlotCount; ++i)
+        {
+            m_slots[level][i].prev = &m_slots[level][i];
+            m_slots[level][i].next = &m_slots[level][i];
+        }
+    }
+
+    m_expired.prev = &m_expired;
+    m_expired.next = &m_expired;
+}
+
+TimerWheel::~TimerWheel()
+{
+    qDeleteAll(m_timers);
+}
+
+void TimerWheel::link(Timer *list, Timer *timer)
+{
+    timer->prev = list->prev;
+    timer->next = list;
+    list->prev->next = timer;
+    list->prev = timer;
+}
+
+void TimerWheel::unlink(Timer *timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer;
+    timer->next = timer;
+}
+
+quint64 TimerWheel::framesFromMsecs(qint64 msecs) const
+{
+    if(msecs <= 0)
+    {
+        return 0;
+    }
+
+    // Rounded up, a timer never fires early
+    const quint64 denominator = quint64(m_clock->frameRateDenominator()) * 1000;
+
+    return (quint64(msecs) * m_clock->frameRateNumerator() + denominator - 1) / denominator;
+}
+
+int TimerWheel::schedule(quint64 frame, QObject *receiver, const char *member)
+{
+    Timer *timer = new Timer;
+    timer->id = m_nextId++;
+    // Timers for a frame that already started go out with the next one
+    timer->frame = qMax(frame, m_currentFrame + 1);
+    timer->receiver = receiver;
+    timer->member = member;
+
+    // Ids wrap after a couple of billion timers, skip any still in use
+    while(m_nextId <= 0 || m_timers.contains(m_nextId))
+    {
+        m_nextId = m_nextId <= 0 ? 1 : m_nextId + 1;
+    }
+
+    m_timers.insert(timer->id, timer);
+    insert(timer);
+
+    return timer->id;
+}
+
+int TimerWheel::scheduleAfter(qint64 msecs, QObject *receiver, const char *member)
+{
+    return schedule(m_currentFrame + qMax(quint64(1), framesFromMsecs(msecs)), receiver, member);
+}
+
+void TimerWheel::cancel(int id)
+{
+    Timer *timer = m_timers.take(id);
+
+    if(timer)
+    {
+        unlink(timer);
+        delete timer;
+    }
+}
+
+quint64 TimerWheel::dueFrame(int id) const
+{
+    Timer *timer = m_timers.value(id);
+
+    return timer ? timer->frame : 0;
+}
+
+void TimerWheel::insert(Timer *timer)
+{
+    // A timer cascaded down for the current frame lands in the level 0
+    // slot that advance() empties right after the cascade
+    quint64 difference = timer->frame ^ m_currentFrame;
+
+    for(int level = 0; level < LevelCount; ++level)
+    {
+        if(difference < (quint64(1) << (SlotBits * (level + 1))) || level == LevelCount - 1)
+        {
+            // Further out than the wheel covers, the timer comes around again on the top level
+            int slot = (timer->frame >> (SlotBits * level)) & (SlotCount - 1);
+            link(&m_slots[level][slot], timer);
+            return;
+        }
+    }
+}
+
+void TimerWheel::cascade(int level)
+{
+    int slot = (m_currentFrame >> (SlotBits * level)) & (SlotCount - 1);
+    Timer *list = &m_slots[level][slot];
+    QList<Timer*> timers;
+
+    // Timers beyond the wheel's range go back into the same slot
+    while(list->next != list)
+    {
+        Timer *timer = list->next;
+        unlink(timer);
+        timers.append(timer);
+    }
+
+    foreach(Timer *timer, timers)
+    {
+        insert(timer);
+    }
+}
+
+void TimerWheel::rebase(quint64 frame)
+{
+    // The clock was restarted, timers keep the number of frames they had left
+    QList<Timer*> timers = m_timers.values();
+    quint64 previousFrame = m_currentFrame;
+
+    foreach(Timer *timer, timers)
+    {
+        unlink(timer);
+        timer->frame = frame + (timer->frame - m_currentFrame);
+    }
+
+    m_currentFrame = frame;
+
+    foreach(Timer *timer, timers)
+    {
+        insert(timer);
+    }
+
+    emit rebased(previousFrame, frame);
+}
+
+void TimerWheel::advance(quint64 frame)
+{
+    if(frame < m_currentFrame)
+    {
+        rebase(frame);
+        return;
+    }
+
+    // Nothing to fire on the way, no need to walk the frames
+    if(m_timers.isEmpty())
+    {
+        m_currentFrame = frame;
+        return;
+    }
+
+    while(m_currentFrame < frame)
+    {
+        ++m_currentFrame;
+
+        // Move the timers of the next higher slot down whenever a level
+        // wraps, from the top so they can go on down through the levels
+        int wrapped = 0;
+
+        while(wrapped + 1 < LevelCount && (m_currentFrame & ((quint64(1) << (SlotBits * (wrapped + 1))) - 1)) == 0)
+        {
+            ++wrapped;
+        }
+
+        for(int level = wrapped; level > 0; --level)
+        {
+            cascade(level);
+        }
+
+        Timer *list = &m_slots[0][m_currentFrame & (SlotCount - 1)];
+
+        while(list->next != list)
+        {
+            Timer *timer = list->next;
+            unlink(timer);
+            link(&m_expired, timer);
+        }
+
+        // Actions may schedule or cancel other timers, including expired ones
+        while(m_expired.next != &m_expired)
+        {
+            Timer *timer = m_expired.next;
+            unlink(timer);
+            m_timers.remove(timer->id);
+
+            if(timer->receiver && !QMetaObject::invokeMethod(timer->receiver, timer->member.constData(), Qt::DirectConnection))
+            {
+                qDebug() << "Failed to call" << timer->member << "on" << timer->receiver;
+            }
+
+            delete timer;
+        }
+    }
+}
+
+int TimerWheel::check()
+{
+    FrameClock clock;
+    TimerWheel wheel(&clock);
+    int failures = 0;
+
+    // Timers only count as fired once advance() has walked their frame
+    wheel.advance(100);
+
+    QList<quint64> frames;
+    frames << 255 << 256 << 257 << 511 << 512 << 65535 << 65536 << 65537
+           << 131072 << 16777215 << 16777216 << 16777217;
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        QList<QPair<quint64, int> > timers;
+
+        foreach(quint64 frame, frames)
+        {
+            timers.append(qMakePair(frame, wheel.schedule(frame, 0, "")));
+        }
+
+        for(int i = 0; i < timers.count(); ++i)
+        {
+            quint64 frame = timers.at(i).first;
+            int id = timers.at(i).second;
+
+            wheel.advance(frame - 1);
+
+            if(!wheel.isScheduled(id))
+            {
+                qDebug() << "Timer for frame" << frame << "fired early";
+                ++failures;
+            }
+
+            wheel.advance(frame);
+
+            if(wheel.isScheduled(id))
+            {
+                qDebug() << "Timer for frame" << frame << "did not fire on its frame";
+                ++failures;
+            }
+        }
+
+        // Again from a current frame that is not on a boundary
+        for(int i = 0; i < frames.count(); ++i)
+        {
+            frames[i] += 16777216 + 100;
+        }
+    }
+
+    qDebug() << "Timer wheel check" << (failures ? "failed" : "passed");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+// Copyright 2012  Peter Simonsson <peter.simonsson@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QObject>
+#include <QHash>
+#include <QPointer>
+#include <QByteArray>
+
+class FrameClock;
+
+// Single shot timers counted in output frames. The wheel is advanced by
+// the frame clock's ticks, so a timer fires at the start of exactly the
+// frame it was scheduled for and its action lands in that frame.
+//
+// Four levels of 256 slots each cover 2^32 frames. A timer is placed by
+// the highest bits in which its frame differs from the current one, and
+// moves down a level whenever the lower levels wrap around. Scheduling
+// and cancelling are constant time.
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TimerWheel(FrameClock *clock, QObject *parent = 0);
+    ~TimerWheel();
+
+    // Calls the slot called member, e.g. "toggleOnAir", of receiver on the
+    // given frame and returns an id for cancel()
+    int schedule(quint64 frame, QObject *receiver, const char *member);
+    int scheduleAfter(qint64 msecs, QObject *receiver, const char *member);
+    void cancel(int id);
+
+    bool isScheduled(int id) const { return m_timers.contains(id); }
+    quint64 dueFrame(int id) const;
+
+    quint64 currentFrame() const { return m_currentFrame; }
+    quint64 framesFromMsecs(qint64 msecs) const;
+    int timerCount() const { return m_timers.count(); }
+
+    // Checks that timers across level boundaries fire on their frame,
+    // returns 0 on success
+    static int check();
+
+public slots:
+    void advance(quint64 frame);
+
+private:
+    static const int LevelCount = 4;
+    static const int SlotBits = 8;
+    static const int SlotCount = 1 << SlotBits;
+
+    struct Timer
+    {
+        int id;
+        quint64 frame;
+        QPointer<QObject> receiver;
+        QByteArray member;
+        Timer *prev;
+        Timer *next;
+    };
+
+    void insert(Timer *timer);
+    void cascade(int level);
+    void rebase(quint64 frame);
+
+    static void link(Timer *list, Timer *timer);
+    static void unlink(Timer *timer);
+
+    FrameClock *m_clock;
+    quint64 m_currentFrame;
+    int m_nextId;
+
+    // Each slot is the sentinel of a circular list
+    Timer m_slots[LevelCount][SlotCount];
+    Timer m_expired;
+    QHash<int, Timer*> m_timers;
+
+signals:
+    // The clock was restarted, e.g. for a new frame rate
+    void rebased(quint64 previousFrame, quint64 frame);
+};
+
+#endif // TIMERWHEEL_H
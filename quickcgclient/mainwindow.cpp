@@ -20,11 +20,12 @@
 #include "graphicpropertiesdialog.h"
 
 #include <QMessageBox>
-#include <QStringListModel>
+#include <QStandardItemModel>
 #include <QInputDialog>
 #include <QSettings>
 #include <QKeyEvent>
 #include <QItemSelectionModel>
+#include <QStatusBar>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -48,6 +49,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(m_connection, SIGNAL(templateListReceived(QStringList)),
             this, SLOT(createGraphic(QStringList)));
 
+    connect(ui->actionCueGraphic, SIGNAL(triggered()),
+            this, SLOT(onCueGraphic()));
+    connect(m_connection, SIGNAL(graphicCued(QString,bool)),
+            this, SLOT(showGraphicCued(QString,bool)));
+
     connect(ui->actionEditGraphic, SIGNAL(triggered()),
             this, SLOT(onEditGraphic()));
     connect(m_connection, SIGNAL(graphicPropertiesReceived(QString,bool,int,QString,QList<QPair<QString,QVariant> >)),
@@ -71,7 +77,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(m_connection, SIGNAL(graphicListChanged(QStringList)),
             this, SLOT(updateGraphicList(QStringList)));
 
-    m_graphicModel = new QStringListModel(ui->m_graphicTreeView);
+    m_graphicModel = new QStandardItemModel(ui->m_graphicTreeView);
     ui->m_graphicTreeView->setModel(m_graphicModel);
 
     connect(ui->m_graphicTreeView, SIGNAL(doubleClicked(QModelIndex)),
@@ -83,11 +89,15 @@ MainWindow::MainWindow(QWidget *parent) :
             this, SLOT(addGraphic(QString)));
     connect(m_connection, SIGNAL(graphicRemoved(QString)),
             this, SLOT(removeGraphic(QString)));
+    connect(m_connection, SIGNAL(thumbnailReceived(QString,QImage)),
+            this, SLOT(updateThumbnail(QString,QImage)));
 
     connect(m_connection, SIGNAL(showListReceived(QStringList,QString)),
             this, SLOT(updateShowList(QStringList,QString)));
     connect(ui->m_showCombo, SIGNAL(activated(QString)),
             this, SLOT(onCurrentShowChanged(QString)));
+    connect(m_connection, SIGNAL(showLoadProgress(QString,int,int)),
+            this, SLOT(updateLoadProgress(QString,int,int)));
 
     ui->m_graphicTreeView->installEventFilter(this);
 
@@ -141,7 +151,13 @@ void MainWindow::onDisconnected()
 
 void MainWindow::updateGraphicList(const QStringList &list)
 {
-    m_graphicModel->setStringList(list);
+    m_graphicModel->clear();
+
+    foreach(const QString &graphic, list)
+    {
+        m_graphicModel->appendRow(new QStandardItem(graphic));
+        m_connection->fetchThumbnail(graphic);
+    }
 }
 
 void MainWindow::toggleGraphicOnAir(const QModelIndex &index)
@@ -162,6 +178,30 @@ void MainWindow::createGraphic(const QStringList &templates)
     }
 }
 
+void MainWindow::onCueGraphic()
+{
+    QModelIndexList indexes = ui->m_graphicTreeView->selectionModel()->selectedIndexes();
+
+    if(indexes.isEmpty())
+    {
+        return;
+    }
+
+    QString graphic = m_graphicModel->data(indexes.first(), Qt::DisplayRole).toString();
+    m_connection->cueGraphic(graphic);
+}
+
+void MainWindow::showGraphicCued(const QString &graphic, bool ready)
+{
+    if(!ready)
+    {
+        statusBar()->showMessage(tr("%1 failed to load").arg(graphic), 3000);
+        return;
+    }
+
+    statusBar()->showMessage(tr("%1 is ready to take").arg(graphic), 3000);
+}
+
 void MainWindow::onEditGraphic()
 {
     QModelIndexList indexes = ui->m_graphicTreeView->selectionModel()->selectedIndexes();
@@ -222,20 +262,28 @@ void MainWindow::onRemoveGraphic()
 
 void MainWindow::addGraphic(const QString &graphic)
 {
-    m_graphicModel->insertRows(m_graphicModel->rowCount(), 1);
-    m_graphicModel->setData(m_graphicModel->index(m_graphicModel->rowCount() - 1), graphic);
+    m_graphicModel->appendRow(new QStandardItem(graphic));
+    m_connection->fetchThumbnail(graphic);
     editGraphic(graphic);
 }
 
 void MainWindow::removeGraphic(const QString &graphic)
 {
-    for(int i = 0; i < m_graphicModel->rowCount(); ++i)
+    QList<QStandardItem*> items = m_graphicModel->findItems(graphic);
+
+    if(!items.isEmpty())
     {
-        if(m_graphicModel->data(m_graphicModel->index(i), Qt::DisplayRole).toString() == graphic)
-        {
-            m_graphicModel->removeRows(i, 1);
-            break;
-        }
+        m_graphicModel->removeRow(items.first()->row());
+    }
+}
+
+void MainWindow::updateThumbnail(const QString &graphic, const QImage &image)
+{
+    QList<QStandardItem*> items = m_graphicModel->findItems(graphic);
+
+    if(!items.isEmpty())
+    {
+        items.first()->setIcon(QIcon(QPixmap::fromImage(image)));
     }
 }
 
@@ -271,6 +319,18 @@ void MainWindow::onRemoveShow()
     m_connection->removeCurrentShow();
 }
 
+void MainWindow::updateLoadProgress(const QString &show, int loaded, int total)
+{
+    if(loaded < total)
+    {
+        statusBar()->showMessage(tr("Loading %1: %2 of %3 graphics").arg(show).arg(loaded).arg(total));
+    }
+    else
+    {
+        statusBar()->clearMessage();
+    }
+}
+
 bool MainWindow::eventFilter(QObject *watched, QEvent *event)
 {
     Q_UNUSED(watched)
@@ -305,6 +365,7 @@ void MainWindow::showGraphicContextMenu(const QPoint &pos)
 
     if(index.isValid())
     {
+        menu->addAction(ui->actionCueGraphic);
         menu->addAction(ui->actionEditGraphic);
         menu->addAction(ui->actionRemoveGraphic);
     }
@@ -19,7 +19,7 @@
 #include <QMainWindow>
 
 class ServerConnection;
-class QStringListModel;
+class QStandardItemModel;
 class QModelIndex;
 
 namespace Ui {
@@ -48,6 +48,9 @@ protected slots:
 
     void createGraphic(const QStringList &templates);
 
+    void onCueGraphic();
+    void showGraphicCued(const QString &graphic, bool ready);
+
     void onEditGraphic();
     void editGraphic(const QString& graphic);
     void editGraphicProperties(const QString &graphic, bool onAirTimerEnabled, int onAirTimerInterval,
@@ -57,11 +60,13 @@ protected slots:
 
     void addGraphic(const QString &graphic);
     void removeGraphic(const QString &graphic);
+    void updateThumbnail(const QString &graphic, const QImage &image);
 
     void updateShowList(const QStringList &list, const QString &current);
     void onNewShow();
     void onCurrentShowChanged(const QString &showName);
     void onRemoveShow();
+    void updateLoadProgress(const QString &show, int loaded, int total);
 
     void showGraphicContextMenu(const QPoint &pos);
 
@@ -70,7 +75,7 @@ private:
 
     ServerConnection *m_connection;
 
-    QStringListModel *m_graphicModel;
+    QStandardItemModel *m_graphicModel;
 };
 
 #endif // MAINWINDOW_H
@@ -19,9 +19,10 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QSettings>
 
 ServerConnection::ServerConnection(QObject *parent) :
-    QObject(parent)
+    QObject(parent), m_channel(QSettings().value("Connection/Channel", 0).toInt())
 {
     initCommandHash();
 
@@ -88,6 +89,12 @@ void ServerConnection::parseCommand(const QJsonDocument &jsonDoc)
         return;
     }
 
+    // The server broadcasts the changes of all its channels
+    if(object.value("Channel").toInt(m_channel) != m_channel)
+    {
+        return;
+    }
+
     QByteArray command = m_commandHash.value(object.value("Command").toString());
     QJsonValue data = object.value("Data");
     QMetaObject::invokeMethod(this, command, Q_ARG(QJsonValue, data));
@@ -97,6 +104,7 @@ void ServerConnection::sendCommand(const QString &command, const QJsonValue &dat
 {
     QJsonObject object;
     object.insert("Command", command);
+    object.insert("Channel", m_channel);
 
     if(!data.isNull())
     {
@@ -120,6 +128,16 @@ void ServerConnection::toggleGraphicOnAir(const QString &name)
     sendCommand("toggle state", name);
 }
 
+void ServerConnection::cueGraphic(const QString &name)
+{
+    sendCommand("cue graphic", name);
+}
+
+void ServerConnection::fetchThumbnail(const QString &graphic)
+{
+    sendCommand("get thumbnail", graphic);
+}
+
 void ServerConnection::initCommandHash()
 {
     m_commandHash.insert("graphics", "parseGraphics");
@@ -129,6 +147,9 @@ void ServerConnection::initCommandHash()
     m_commandHash.insert("graphic removed", "parseGraphicRemoved");
     m_commandHash.insert("shows", "parseShows");
     m_commandHash.insert("graphic state changed", "parseGraphicStateChanged");
+    m_commandHash.insert("cued", "parseGraphicCued");
+    m_commandHash.insert("graphic thumbnail", "parseGraphicThumbnail");
+    m_commandHash.insert("show load progress", "parseShowLoadProgress");
 }
 
 void ServerConnection::parseGraphics(const QJsonValue &data)
@@ -236,6 +257,21 @@ void ServerConnection::parseGraphicRemoved(const QJsonValue &data)
     emit graphicRemoved(graphic);
 }
 
+void ServerConnection::parseGraphicThumbnail(const QJsonValue &data)
+{
+    QJsonObject object = data.toObject();
+    QByteArray imageData = QByteArray::fromBase64(object.value("image").toString().toLatin1());
+    QImage image = QImage::fromData(imageData, object.value("format").toString().toLatin1());
+
+    if(image.isNull())
+    {
+        qDebug() << "Failed to decode thumbnail for graphic" << object.value("graphic").toString();
+        return;
+    }
+
+    emit thumbnailReceived(object.value("graphic").toString(), image);
+}
+
 void ServerConnection::fetchShowList()
 {
     sendCommand("list shows");
@@ -262,6 +298,13 @@ void ServerConnection::parseShows(const QJsonValue &data)
     emit showListReceived(shows, current);
 }
 
+void ServerConnection::parseShowLoadProgress(const QJsonValue &data)
+{
+    QJsonObject object = data.toObject();
+
+    emit showLoadProgress(object.value("Show").toString(), object.value("Loaded").toInt(), object.value("Total").toInt());
+}
+
 void ServerConnection::createNewShow(const QString &name)
 {
     sendCommand("create show", name);
@@ -287,6 +330,14 @@ void ServerConnection::parseGraphicStateChanged(const QJsonValue &data)
     QJsonObject object = data.toObject();
     QString graphic = object.value("graphic").toString();
     bool state = object.value("state").toBool();
+    QString phase = object.value("phase").toString();
+
+    qDebug() << "State change in" << graphic << "to" << state << phase;
+}
+
+void ServerConnection::parseGraphicCued(const QJsonValue &data)
+{
+    QJsonObject object = data.toObject();
 
-    qDebug() << "State change in" << graphic << "to" << state;
+    emit graphicCued(object.value("graphic").toString(), object.value("ready").toBool(true));
 }
@@ -19,6 +19,7 @@
 #include <QObject>
 #include <QTcpSocket>
 #include <QJsonValue>
+#include <QImage>
 
 class QJsonDocument;
 
@@ -30,6 +31,8 @@ public:
 
     void fetchGraphicList();
     void toggleGraphicOnAir(const QString &name);
+    void cueGraphic(const QString &name);
+    void fetchThumbnail(const QString &graphic);
 
 public slots:
     void connectToServer(const QString &address, quint16 port);
@@ -58,8 +61,11 @@ protected slots:
     void parseGraphicAdded(const QJsonValue &data);
     void parseGraphicRemoved(const QJsonValue &data);
     void parseGraphicStateChanged(const QJsonValue &data);
+    void parseGraphicCued(const QJsonValue &data);
+    void parseGraphicThumbnail(const QJsonValue &data);
 
     void parseShows(const QJsonValue &data);
+    void parseShowLoadProgress(const QJsonValue &data);
 
 protected:
     void parseCommand(const QJsonDocument &jsonDoc);
@@ -73,6 +79,7 @@ private:
     QHash<QString, QByteArray> m_commandHash;
 
     QString m_currentShow;
+    int m_channel;
 
 signals:
     void connected();
@@ -85,8 +92,11 @@ signals:
                                    const QString& group, const QList<QPair<QString, QVariant> > &propertyList);
     void graphicAdded(const QString &graphic);
     void graphicRemoved(const QString &graphic);
+    void graphicCued(const QString &graphic, bool ready);
+    void thumbnailReceived(const QString &graphic, const QImage &image);
 
     void showListReceived(const QStringList &list, const QString &current);
+    void showLoadProgress(const QString &show, int loaded, int total);
 };
 
 #endif // SERVERCONNECTION_H